@@ -8,7 +8,7 @@
  *              and also implements detection of
  *                - shortTouch
  *                - longTouch
- *                - swipes right, up, right, down
+ *                - swipes right, up, left, down
  *                - and a loop() function which can be called in the main loop. 
  *              To react to events in the loop function, 6 callback functions can be installed:
  *                - onShortTouch
@@ -17,6 +17,42 @@
  *                - onSwipeUp
  *                - onSwipeLeft
  *                - onSwipeDown
+ *              The gestures are recognized incrementally from every sample, swipes
+ *              and long touches fire while the pen is still down (see XPT2046_Gesture.h).
+ *              For continuous tracking (sliders, scroll lists) 3 more callbacks 
+ *              receive a TouchEvent with position, displacement, velocity and time:
+ *                - onPenDown
+ *                - onMove      rate limited, intermediate samples are coalesced
+ *                - onPenUp
+ *              Any number of handlers up to XPT2046_MAX_SUBSCRIBERS per event type
+ *              can be registered with subscribe(), each with a context pointer
+ *              (see XPT2046_Dispatch.h).
+ * 
+ *              The software SPI drives the pins through the GPIO set/clear registers
+ *              (see XPT2046_Gpio.h) and is clocked by the CPU cycle counter, so the
+ *              clock rate can be chosen with setClockFrequency() up to 2 MHz.
+ *              Instead of the software SPI another backend, e.g. the hardware SPI,
+ *              can be passed to the constructor (see XPT2046_Transport.h).
+ *              benchmarkTransport() prints the sample rate of the backend in use.
+ *              getSampleCycles() returns the cycles spent by the last getTouch().
+ *              startTrace() records the raw samples into a file or Serial, 
+ *              replayTrace() feeds such a trace back through the calibration 
+ *              and the gesture recognizer (see XPT2046_Trace.h).
+ *              With -D XPT2046_METRICS=1 the driver counts samples, rejections, 
+ *              events and cycles per sample, printMetrics() prints them.
+ *              With useIrq(TP_IRQ) the PENIRQ output of the XPT2046 is used: the
+ *              controller is only sampled while the pen is down and waitForTouch()
+ *              blocks (or light sleeps) until the next touch.
+ *              The raw values are mapped to the screen by an affine transform fitted
+ *              to 2 or more calibration points (see XPT2046_Calibration.h).
+ *              Each axis is oversampled and filtered (median or trimmed mean, 
+ *              see XPT2046_Filter.h).
+ *              The pen state is derived from the touch resistance calculated from
+ *              Z1, Z2 and the X plate resistance, with hysteresis between pen down
+ *              and pen up (see XPT2046_Pressure.h). Idle samples end after Z1.
+ *              startSamplingTask() moves the sampling to a FreeRTOS task that feeds
+ *              a lock-free queue of timestamped samples (see XPT2046_EventQueue.h),
+ *              which is drained by loop() or by the application with readSample().
  * 
  * Caveats      This class replaces the touch functions in the Lovayn LGFX library.
  *              Therefore, the section for the touchscreen in the configuration 
@@ -34,35 +70,214 @@
  */
 
 #include "XPT2046_Bitbang.h"
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <esp_sleep.h>
+  #include <driver/gpio.h>
+#endif
 
 //extern bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename);
 
 XPT2046_Bitbang::XPT2046_Bitbang(LGFX &lcd, uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin) : 
-                                 _lcd(lcd), _mosiPin(mosiPin), _misoPin(misoPin), _clkPin(clkPin), _csPin(csPin) 
+                                 _lcd(lcd), _bitbangBus(mosiPin, misoPin, clkPin, csPin), _bus(&_bitbangBus) 
+{
+    _useDefaultCalibration();
+    fitAffineTransform(_cal, _calXform, &_calResidual);
+    _screen = _screenTransform(0);
+}
+
+
+/**
+ * Uses the supplied bus backend instead of the built-in software SPI
+ */
+XPT2046_Bitbang::XPT2046_Bitbang(LGFX &lcd, XPT2046_Transport &bus) : 
+                                 _lcd(lcd), _bitbangBus(0, 0, 0, 0), _bus(&bus)
+{
+    _useDefaultCalibration();
+    fitAffineTransform(_cal, _calXform, &_calResidual);
+    _screen = _screenTransform(0);
+}
+
+
+void XPT2046_Bitbang::_useDefaultCalibration()
 {
 // Values from my CYD W=320 x H=240 in LANDSCAPE_USB_RIGHT mode, W is the
 // larger dimension. The reference points here are 40/40 and 280/200 and the 
 // corresponding values detected are 646/1034 and 3365/3165
 // These values are overwritten by the data in the preferences when 
 // restoreCalibrationData() is called.
-    _cal = TouchCalibration {{ 40, 40,  646,1034,0}, 
-                             {280,200, 3365,3165,0}};
+    _cal = TouchCalibration {2, {{ 40, 40,  646,1034,0,0}, 
+                                 {280,200, 3365,3165,0,0}}};
+}
+
+
+/**
+ * Fits the affine transform to the calibration points and folds the 
+ * current screen rotation into it. The new transform replaces the 
+ * active one atomically, getTouch() may run on another task.
+ */
+bool XPT2046_Bitbang::_updateTransform()
+{
+    AffineTransform calXform;
+    float residual;
+    if (! fitAffineTransform(_cal, calXform, &residual))
+    {
+      log_e("==> calibration points are degenerate");
+      return false;
+    }
+    portENTER_CRITICAL(&_xformMux);
+    _calXform = calXform;
+    _calResidual = residual;
+    _screen = _screenTransform(_screen.rotation);
+    portEXIT_CRITICAL(&_xformMux);
+    return true;
+}
+
+
+/**
+ * Builds the screen transform for the given rotation
+ * from the calibration transform
+ */
+XPT2046_Bitbang::ScreenTransform XPT2046_Bitbang::_screenTransform(uint8_t rotation)
+{
+    ScreenTransform st;
+    st.rotation = rotation;
+    st.xform = rotateAffineTransform(_calXform, rotation, TFT_WIDTH, TFT_HEIGHT);
+    st.xMax = (rotation & 1) ? TFT_HEIGHT : TFT_WIDTH;
+    st.yMax = (rotation & 1) ? TFT_WIDTH  : TFT_HEIGHT;
+    return st;
 }
 
 
 /**
- * Initialize the pins and 
+ * Initialize the bus and 
  * get the screen orientation
  */
 void XPT2046_Bitbang::begin() 
 {
-    pinMode(_mosiPin, OUTPUT);
-    pinMode(_misoPin, INPUT);
-    pinMode(_clkPin, OUTPUT);
-    pinMode(_csPin, OUTPUT);
-    digitalWrite(_csPin, HIGH);
-    digitalWrite(_clkPin, LOW);
-    _rotation = _lcd.getRotation();
+    _bus->begin();
+    portENTER_CRITICAL(&_xformMux);
+    _screen = _screenTransform(_lcd.getRotation());
+    portEXIT_CRITICAL(&_xformMux);
+}
+
+
+/**
+ * Sets the clock frequency of the bus backend.
+ * The frequency is limited to XPT2046_MAX_CLOCK_HZ (2 MHz)
+ */
+void XPT2046_Bitbang::setClockFrequency(uint32_t hz)
+{
+    _bus->setClockFrequency(hz);
+}
+
+
+/**
+ * Uses the PENIRQ output of the XPT2046 (active low) to detect the pen.
+ * As long as the pen is up getTouch() returns false without talking 
+ * to the controller, the last conversion of each sample powers the 
+ * controller down with PENIRQ enabled.
+ */
+void XPT2046_Bitbang::useIrq(uint8_t irqPin)
+{
+    _irqPin = irqPin;
+    pinMode(irqPin, INPUT);
+    _irq.attach(irqPin);
+    attachInterruptArg(digitalPinToInterrupt(irqPin), _onPenIrq, this, FALLING);
+}
+
+
+/**
+ * Wakes up the task waiting in waitForTouch().
+ * The interrupt is also triggered during conversions, 
+ * which is harmless because the waiter checks the pin.
+ */
+void IRAM_ATTR XPT2046_Bitbang::_onPenIrq(void *arg)
+{
+    XPT2046_Bitbang *self = static_cast<XPT2046_Bitbang *>(arg);
+    TaskHandle_t task = self->_waitingTask;
+    if (task)
+    {
+      BaseType_t woken = pdFALSE;
+      vTaskNotifyGiveFromISR(task, &woken);
+      if (woken) portYIELD_FROM_ISR();
+    }
+}
+
+
+/**
+ * Returns true if PENIRQ signals a touch. Without 
+ * IRQ pin the pen state is unknown and true is returned.
+ */
+bool XPT2046_Bitbang::isPenDown()
+{
+    return _irqPin < 0 || _irq.read() == 0;
+}
+
+
+/**
+ * Blocks until the pen goes down or msTimeout has expired and
+ * returns true if the pen is down. The task sleeps while waiting, 
+ * with lightSleep = true the whole chip enters light sleep.
+ * Without IRQ pin it just waits msTimeout.
+ */
+bool XPT2046_Bitbang::waitForTouch(uint32_t msTimeout, bool lightSleep)
+{
+    if (_irqPin < 0) 
+    {
+      delay(msTimeout);
+      return true;
+    }
+    if (isPenDown()) return true;
+
+#if defined(ARDUINO_ARCH_ESP32)
+    if (lightSleep)
+    {
+      gpio_wakeup_enable((gpio_num_t)_irqPin, GPIO_INTR_LOW_LEVEL);
+      esp_sleep_enable_gpio_wakeup();
+      esp_sleep_enable_timer_wakeup((uint64_t)msTimeout * 1000ULL);
+      esp_light_sleep_start();
+      gpio_wakeup_disable((gpio_num_t)_irqPin);
+      return isPenDown();
+    }
+#else
+    (void)lightSleep;
+#endif
+
+    _waitingTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);         // discard an old notification
+    if (! isPenDown()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(msTimeout));
+    _waitingTask = nullptr;
+    return isPenDown();
+}
+
+
+/**
+ * Sets the resistance of the X plate of the touch panel in ohms,
+ * it scales the touch resistance returned in TouchPoint::rTouch
+ */
+void XPT2046_Bitbang::setPlateResistance(uint16_t rxPlate)
+{
+    _pressure.setPlateResistance(rxPlate);
+}
+
+
+/**
+ * Sets the touch resistances in ohms at which the pen goes down and 
+ * up again. rPenUp > rPenDown keeps a light touch from flickering.
+ */
+void XPT2046_Bitbang::setPressureThresholds(uint16_t rPenDown, uint16_t rPenUp)
+{
+    _pressure.setThresholds(rPenDown, rPenUp);
+}
+
+
+/**
+ * Returns the number of CPU cycles the last call 
+ * of getTouch() spent talking to the XPT2046
+ */
+uint32_t XPT2046_Bitbang::getSampleCycles()
+{
+    return _sampleCycles;
 }
 
 /**
@@ -77,26 +292,158 @@ void XPT2046_Bitbang::_crosshair(TouchPoint p, int s, uint16_t color)
 
 
 /**
- * Saves the calibration data in preferences
+ * Saves the calibration data in preferences. The calibration is 
+ * already active, it is written to the NVS by a background task. 
+ * With restart = true the data is written immediately and the 
+ * ESP32 is restarted afterwards.
+ */
+void XPT2046_Bitbang::saveCalibrationData(bool restart) 
+{
+  _storedCal = _cal;
+  _calStored = 1;
+  if (restart)
+  {
+    _waitForPersist();
+    if (!_writeCalibration(_cal)) Serial.println("Failed to save the calibration data");
+    ESP.restart();
+  }
+  _persist(PERSIST_SAVE);
+}
+
+
+/**
+ * Hands the pending NVS operation over to the persist task
+ * and starts the task if it is not already running
+ */
+void XPT2046_Bitbang::_persist(uint8_t op)
+{
+  bool start;
+  portENTER_CRITICAL(&_xformMux);
+  _persistOp = op;
+  _persistCal = _storedCal;
+  start = !_persistBusy;
+  _persistBusy = true;
+  portEXIT_CRITICAL(&_xformMux);
+
+  if (start && xTaskCreate(_persistTaskFn, "calsave", 4096, this, 1, nullptr) != pdPASS)
+  {
+    log_e("==> failed to create the persist task, writing synchronously");
+    while (_doPersist()) {}
+  }
+}
+
+
+/**
+ * Executes the pending NVS operations until none is left
+ */
+void XPT2046_Bitbang::_persistTaskFn(void *arg)
+{
+  XPT2046_Bitbang *self = static_cast<XPT2046_Bitbang *>(arg);
+  while (self->_doPersist()) {}
+  vTaskDelete(nullptr);
+}
+
+
+/**
+ * Executes the pending NVS operation. Returns false and releases
+ * the persist task if there was nothing to do.
+ */
+bool XPT2046_Bitbang::_doPersist()
+{
+  uint8_t op;
+  TouchCalibration cal;
+  portENTER_CRITICAL(&_xformMux);
+  op = _persistOp;
+  cal = _persistCal;
+  _persistOp = PERSIST_NONE;
+  if (op == PERSIST_NONE) _persistBusy = false;
+  portEXIT_CRITICAL(&_xformMux);
+
+  switch (op)
+  {
+    case PERSIST_SAVE:
+      if (!_writeCalibration(cal)) log_e("==> failed to save the calibration data");
+      else log_i("==> calibration data saved");
+    break;
+
+    case PERSIST_CLEAR:
+      _prefs.begin("CALDATA");
+      _prefs.clear();
+      _prefs.end();
+      log_i("==> calibration data cleared");
+    break;
+  }
+  return op != PERSIST_NONE;
+}
+
+
+/**
+ * Waits until the persist task has finished
+ */
+void XPT2046_Bitbang::_waitForPersist()
+{
+  while (_persistBusy) delay(1);
+}
+
+
+/**
+ * Writes the calibration as a single CRC protected blob 
+ * (see XPT2046_Calibration.h) and removes all other keys
  */
-void XPT2046_Bitbang::saveCalibrationData() 
+bool XPT2046_Bitbang::_writeCalibration(const TouchCalibration &cal)
 {
-  if (!_prefs.begin("CALDATA")) 
+  uint8_t blob[XPT2046_CAL_BLOB_MAX];
+  size_t len = packCalibration(cal, blob, sizeof(blob));
+  if (len == 0 || !_prefs.begin("CALDATA")) return false;
+  _prefs.clear();
+  bool ok = _prefs.putBytes("CALBLOB", blob, len) == len;
+  _prefs.end();
+  return ok;
+}
+
+
+/**
+ * Reads the calibration blob once into RAM. Data saved in the former 
+ * format with one key per value is converted to a blob. A blob longer
+ * than XPT2046_CAL_BLOB_READ_MAX is taken as corrupted.
+ */
+void XPT2046_Bitbang::_loadCalibration()
+{
+  uint32_t us = micros();
+  bool legacy = false;
+
+  _calStored = 0;
+  if (!_prefs.begin("CALDATA", true)) return; // namespace does not exist yet
+  uint8_t blob[XPT2046_CAL_BLOB_READ_MAX];     // a newer version may append fields
+  size_t len = _prefs.getBytesLength("CALBLOB");
+  if (len > sizeof(blob))
+  {
+    log_e("==> calibration blob of %u bytes is too long", (unsigned)len);
+  }
+  else if (len > 0)
+  {
+    len = _prefs.getBytes("CALBLOB", blob, len);
+    _calStored = unpackCalibration(blob, len, _storedCal) ? 1 : 0;
+    if (!_calStored) log_e("==> calibration blob is invalid");
+  }
+  else if (_prefs.getInt("INIT_FLAG", 0) == 1947)
   {
-    Serial.println("Failed to save the calibration data");
-    return;
+    legacy = true;
+    _calStored = 1;
+    _storedCal = _cal;
+    _storedCal.nbrPoints = 2;
+    _storedCal.point[0].x = _prefs.getInt("xTouchMin");
+    _storedCal.point[0].y = _prefs.getInt("yTouchMin");
+    _storedCal.point[0].xValue = _prefs.getInt("xValueTouchMin");
+    _storedCal.point[0].yValue = _prefs.getInt("yValueTouchMin");
+    _storedCal.point[1].x = _prefs.getInt("xTouchMax");
+    _storedCal.point[1].y = _prefs.getInt("yTouchMax");
+    _storedCal.point[1].xValue = _prefs.getInt("xValueTouchMax");
+    _storedCal.point[1].yValue = _prefs.getInt("yValueTouchMax");
   }
-  _prefs.putInt("INIT_FLAG", 1947);
-  _prefs.putInt("xTouchMin", _cal.touchMin.x);
-  _prefs.putInt("yTouchMin", _cal.touchMin.y);
-  _prefs.putInt("xValueTouchMin", _cal.touchMin.xValue);
-  _prefs.putInt("yValueTouchMin", _cal.touchMin.yValue);
-  _prefs.putInt("xTouchMax", _cal.touchMax.x);
-  _prefs.putInt("yTouchMax", _cal.touchMax.y);
-  _prefs.putInt("xValueTouchMax", _cal.touchMax.xValue);
-  _prefs.putInt("yValueTouchMax", _cal.touchMax.yValue);
   _prefs.end();
-  ESP.restart();
+  if (legacy) _persist(PERSIST_SAVE);
+  log_i("==> calibration data %s in %u us", _calStored ? "loaded" : "not found", micros() - us);
 }
 
 
@@ -106,127 +453,274 @@ void XPT2046_Bitbang::saveCalibrationData()
  */
 void XPT2046_Bitbang::useCalibrationPoints(TouchPoint tp[], int nbrTouches)
 {
-  TouchPoint p;
-  TouchPoint *pCal = &_cal.touchMin;
+  useCalibrationPoints(tp, 2, nbrTouches);
+}
+
+
+/**
+ * Draws nbrPoints calibration points one after the other on the screen
+ * and collects the raw values of each with outlier rejection. A point 
+ * is complete as soon as the samples are consistent, but after 
+ * nbrTouches touches at the latest. The affine transform is then fitted by least squares, 
+ * 3 or more points not on a line also correct rotation and skew.
+ * Blocks until the calibration is complete, use startCalibration() 
+ * and calibrationTick() to keep the application running meanwhile.
+ */
+void XPT2046_Bitbang::useCalibrationPoints(TouchPoint tp[], int nbrPoints, int nbrTouches)
+{
+  startCalibration(tp, nbrPoints, nbrTouches);
+  while (calibrationTick()) delay(5);
+}
+
+
+/**
+ * Starts a non-blocking calibration with nbrPoints points and 
+ * nbrTouches touches each. Call calibrationTick() repeatedly 
+ * until it returns false.
+ */
+void XPT2046_Bitbang::startCalibration(TouchPoint tp[], int nbrPoints, int nbrTouches)
+{
+  if (nbrPoints < 2) return;
+  _calSM.start(tp, nbrPoints, nbrTouches);
+  _crosshair(_calSM.result().point[0], 7, TFT_WHITE); // mark first point
+}
+
+
+/**
+ * Takes one sample and advances the calibration. The target turns 
+ * yellow as soon as enough stable samples are collected (the pen can 
+ * be lifted) and green when the pen is up. When the last point is 
+ * complete, the new calibration is activated and saved. Returns true 
+ * as long as the calibration is running.
+ */
+bool XPT2046_Bitbang::calibrationTick()
+{
+  if (! _calSM.isRunning()) return false;
+
+  TouchPoint p = {0, 0, 0, 0, 0, 0};
+  bool penDown = getTouch(p);
+  return _calibrationStep(penDown, p, millis());
+}
+
+
+/**
+ * Advances the calibration with one sample
+ */
+bool XPT2046_Bitbang::_calibrationStep(bool penDown, const TouchPoint &p, uint32_t ms)
+{
+  const TouchCalibration &cal = _calSM.result();
+  int i = _calSM.currentPoint();
 
-  for (int i = 0; i < 2; i++)
+  switch (_calSM.feed(penDown, p.xValue, p.yValue, ms))
   {
-    int n = 0;
-    pCal->x = tp[i].x;
-    pCal->y = tp[i].y;
-    pCal->xValue = 0;
-    pCal->yValue = 0;
-    _crosshair(*pCal, 7, TFT_WHITE); // mark point
-    while (n < nbrTouches)
+    case CalibrationStateMachine::EV_TOUCH:
+      _crosshair(cal.point[i], 7, TFT_YELLOW);
+    break;
+
+    case CalibrationStateMachine::EV_NEXT_POINT:
+      log_i("==> point %d confidence %d%%", i, _calSM.confidence(i));
+      _crosshair(cal.point[i], 7, TFT_GREEN);
+      _crosshair(cal.point[i + 1], 7, TFT_WHITE);
+    break;
+
+    case CalibrationStateMachine::EV_FINISHED:
     {
-      if (getTouch(p))
+      log_i("==> point %d confidence %d%%", i, _calSM.confidence(i));
+      _crosshair(cal.point[i], 7, TFT_GREEN);
+      //saveBMPtoSD_24bit(_lcd, "/calibration.bmp");
+      TouchCalibration previous = _cal;
+      _cal = cal;
+      if (! _updateTransform()) 
       {
-        pCal->xValue += p.xValue;
-        pCal->yValue += p.yValue;
-        delay(500);
-        n++;
+        _cal = previous;
+        return false;
       }
+      log_i("==> RMS residual of the fit %.2f px", _calResidual);
+      saveCalibrationData();
+      return false;
     }
-    _crosshair(*pCal, 7, TFT_GREEN);
-    pCal->xValue /= nbrTouches;
-    pCal->yValue /= nbrTouches;
-    pCal = &_cal.touchMax;
+
+    default:
+    break;
   }
-  //saveBMPtoSD_24bit(_lcd, "/calibration.bmp");
-  saveCalibrationData();
+  return true;
+}
+
+
+/**
+ * Confidence in percent of the raw values of a point 
+ * of the last calibration (see XPT2046_Calibration.h)
+ */
+int XPT2046_Bitbang::getCalibrationConfidence(int point)
+{
+  return (point >= 0 && point < XPT2046_MAX_CAL_POINTS) ? _calSM.confidence(point) : 0;
+}
+
+
+/**
+ * RMS distance in pixels between the calibration 
+ * targets and the transformed raw values
+ */
+float XPT2046_Bitbang::getCalibrationResidual()
+{
+  return _calResidual;
 }
 
 
+/**
+ * Returns true while a calibration started with 
+ * startCalibration() is in progress
+ */
+bool XPT2046_Bitbang::isCalibrating()
+{
+  return _calSM.isRunning();
+}
+
+
+/**
+ * Returns true if valid calibration data is stored. The data 
+ * is read from the NVS only once and then kept in RAM.
+ */
 bool XPT2046_Bitbang::isCalibrationDataAvailable()
 {
-  bool res = false;
-  if (!_prefs.begin("CALDATA")) return res;
-  res = _prefs.getInt("INIT_FLAG", 0) == 1947 ? true : false;
-  _prefs.end();
-  return res;
+  if (_calStored < 0) _loadCalibration();
+  return _calStored == 1;
 }
 
 
-void XPT2046_Bitbang::clearCalibrationData()
+/**
+ * Deletes the saved calibration data and activates the 
+ * programmed defaults. With restart = true the data is 
+ * deleted immediately and the ESP32 is restarted.
+ */
+void XPT2046_Bitbang::clearCalibrationData(bool restart)
 {
-  _prefs.begin("CALDATA");
-  _prefs.clear();
-  _prefs.end();
-  ESP.restart();
+  _calStored = 0;
+  if (restart)
+  {
+    _waitForPersist();
+    _prefs.begin("CALDATA");
+    _prefs.clear();
+    _prefs.end();
+    ESP.restart();
+  }
+  _useDefaultCalibration();
+  _updateTransform();
+  _persist(PERSIST_CLEAR);
 }
 
 
 bool XPT2046_Bitbang::recallCalibrationData()
 {
-  if (!_prefs.begin("CALDATA", true)) 
+  if (!isCalibrationDataAvailable()) 
   {
     Serial.println("Failed to restore the calibration data");
     return false;
   }
-  _cal.touchMin.x = _prefs.getInt("xTouchMin");
-  _cal.touchMin.y = _prefs.getInt("yTouchMin");
-  _cal.touchMin.xValue = _prefs.getInt("xValueTouchMin");
-  _cal.touchMin.yValue = _prefs.getInt("yValueTouchMin");
-  _cal.touchMax.x = _prefs.getInt("xTouchMax");
-  _cal.touchMax.y = _prefs.getInt("yTouchMax");
-  _cal.touchMax.xValue = _prefs.getInt("xValueTouchMax");
-  _cal.touchMax.yValue = _prefs.getInt("yValueTouchMax");
-  _prefs.end();
+  TouchCalibration previous = _cal;
+  _cal = _storedCal;
+  if (! _updateTransform())
+  {
+    _cal = previous;
+    return false;
+  }
   log_i("==> done");
   return true;
 }
 
 
-void XPT2046_Bitbang::erasePreferences()
+/**
+ * Erases the whole NVS partition and activates the default calibration.
+ * With restart = true the ESP32 is restarted afterwards.
+ */
+void XPT2046_Bitbang::erasePreferences(bool restart)
 {
+    _waitForPersist();
     nvs_flash_erase();      // erase the NVS partition and...
     nvs_flash_init();       // initialize the NVS partition.
-    ESP.restart();
+    if (restart) ESP.restart();
+    _calStored = 0;
+    _useDefaultCalibration();
+    _updateTransform();
 }
 
 void XPT2046_Bitbang::printCalibrationData()
 {
-  Serial.printf("Min: x, y = %4d, %4d  xValue, yValue = %4d, %4d\n", _cal.touchMin.x, _cal.touchMin.y, _cal.touchMin.xValue, _cal.touchMin.yValue);
-  Serial.printf("Max: x, y = %4d, %4d  xValue, yValue = %4d, %4d\n", _cal.touchMax.x, _cal.touchMax.y, _cal.touchMax.xValue, _cal.touchMax.yValue);
+  for (int i = 0; i < _cal.nbrPoints; i++)
+  {
+    const TouchPoint &p = _cal.point[i];
+    Serial.printf("P%d: x, y = %4d, %4d  xValue, yValue = %4d, %4d\n", i, p.x, p.y, p.xValue, p.yValue);
+  }
+  Serial.printf("x = %9.6f * xValue %+9.6f * yValue %+9.3f\n", 
+                (float)_calXform.a / XPT2046_FIX_ONE, (float)_calXform.b / XPT2046_FIX_ONE, (float)_calXform.c / XPT2046_FIX_ONE);
+  Serial.printf("y = %9.6f * xValue %+9.6f * yValue %+9.3f\n", 
+                (float)_calXform.d / XPT2046_FIX_ONE, (float)_calXform.e / XPT2046_FIX_ONE, (float)_calXform.f / XPT2046_FIX_ONE);
+  Serial.printf("RMS residual = %.2f px\n", _calResidual);
 }
 
 /**
- * Write a command to the SPI
+ * Prints the counters of the driver (see XPT2046_Metrics.h), 
+ * build with -D XPT2046_METRICS=1 to enable them
  */
-void XPT2046_Bitbang::_writeSPI(byte command) 
+void XPT2046_Bitbang::printMetrics()
 {
-    for(int i = 7; i >= 0; i--) 
-    {
-        digitalWrite(_mosiPin, command & (1 << i));
-        digitalWrite(_clkPin, LOW);
-        delayMicroseconds(DELAY);
-        digitalWrite(_clkPin, HIGH);
-        delayMicroseconds(DELAY);
-    }
-    digitalWrite(_mosiPin, LOW);
-    digitalWrite(_clkPin, LOW);
+#if XPT2046_METRICS
+  static const char *eventName[TOUCH_EVENT_TYPES] = { "none", "short", "long", "swipeRight", "swipeUp",
+                                                      "swipeLeft", "swipeDown", "penDown", "move", "penUp" };
+  TouchMetrics m = _metrics;
+  Serial.printf("loops %u  samples %u  rejected by Z1 %u  by pressure %u  dropped %u\n", 
+                m.loops, m.samples, m.rejectedZ1, m.rejectedPressure, getDroppedSamples());
+  Serial.printf("bus time %.1f ms  %u cycles/sample\n", 1000.0 * m.busCycles / gpioCyclesPerSecond(), 
+                m.samples ? (uint32_t)(m.busCycles / m.samples) : 0);
+  for (int i = 1; i < TOUCH_EVENT_TYPES; i++) Serial.printf("%s %u  ", eventName[i], m.events[i]);
+  Serial.printf("handlers %u\n", m.handlers);
+  for (int i = 0; i < XPT2046_METRICS_BUCKETS; i++)
+  {
+    if (m.cycles[i] == 0) continue;
+    Serial.printf("%7lu.. cycles %u\n", i ? 1UL << (i + XPT2046_METRICS_MIN_LOG2) : 0UL, m.cycles[i]);
+  }
+#else
+  Serial.println("Metrics are disabled, build with -D XPT2046_METRICS=1");
+#endif
 }
 
 
 /**
- * Read data from the SPI
+ * Takes nbrSamples samples and prints the sample rate and 
+ * the CPU time per sample of the bus backend in use
  */
-uint16_t XPT2046_Bitbang::_readSPI(byte command) 
+void XPT2046_Bitbang::benchmarkTransport(int nbrSamples)
 {
-    _writeSPI(command);
-
-    uint16_t result = 0;
-
-    for(int i = 15; i >= 0; i--) 
+    TouchPoint tp;
+    uint64_t cycles = 0;
+    uint32_t us = micros();
+    for (int i = 0; i < nbrSamples; i++)
     {
-        digitalWrite(_clkPin, HIGH);
-        delayMicroseconds(DELAY);
-        digitalWrite(_clkPin, LOW);
-        delayMicroseconds(DELAY);
-        result |= (digitalRead(_misoPin) << i);
+      getTouch(tp);
+      cycles += _sampleCycles;
     }
+    us = micros() - us;
+    Serial.printf("Transport %-8s %7.0f samples/s  %6.1f us/sample  %7llu cycles/sample\n", 
+                  _bus->name(), 1.0e6 * nbrSamples / us, (float)us / nbrSamples, 
+                  (unsigned long long)(cycles / nbrSamples));
+}
 
-    return result >> 4;
+
+/**
+ * Converts an axis XPT2046_OVERSAMPLING times and returns the filtered
+ * value (see XPT2046_Filter.h). With powerDown = true the last conversion
+ * powers the controller down and enables PENIRQ.
+ */
+uint16_t XPT2046_Bitbang::_readAxis(uint8_t command, bool powerDown)
+{
+    uint16_t v[XPT2046_OVERSAMPLING];
+
+#if XPT2046_DISCARD_FIRST
+    _bus->transfer(command);   // let the reference and the panel settle
+#endif
+    for (int i = 0; i < XPT2046_OVERSAMPLING - 1; i++) v[i] = _bus->transfer(command);
+    v[XPT2046_OVERSAMPLING - 1] = _bus->transfer(powerDown ? command & ~((byte)1) : command);
+    return filterSamples(v);
 }
 
 
@@ -234,58 +728,155 @@ uint16_t XPT2046_Bitbang::_readSPI(byte command)
  * Determines the coordinates of the touched point
  * and returns true if the pressure was strong enough.
  * The coordinates are returned in the reference variable tp.
+ * The pen goes down when the touch resistance falls below
+ * rPenDown and up when it rises above rPenUp (see 
+ * setPressureThresholds() and XPT2046_Pressure.h).
  */
  bool XPT2046_Bitbang::getTouch(TouchPoint& tp) 
  {
-    digitalWrite(_csPin, LOW);
-    tp.zValue = _readSPI(CMD_READ_Z1) + 4095 - _readSPI(CMD_READ_Z2);
+    if (! isPenDown())
+    {
+      _pressure.release();
+      if (_traceOut) _recordTrace(false, TouchPoint {0, 0, 0, 0, 0, 0});
+      return false;
+    }
+
+    // Z1 is converted first and with power down, so that PENIRQ stays 
+    // enabled when the sample ends here. Without touch Z1 is near 0 
+    // and Z2, X and Y are not converted at all.
+    uint32_t t0 = gpioCycles();
+    _bus->select();
+    int z1 = _bus->transfer(CMD_READ_Z1 & ~((byte)1));
+    if (! _pressure.isZ1Active(z1))
+    { 
+      _bus->deselect();
+      _sampleCycles = gpioCycles() - t0;
+      XPT2046_METRIC(_metrics.rejectedZ1++; _metrics.addSample(_sampleCycles));
+      if (_traceOut) _recordTrace(false, TouchPoint {0, 0, 0, 0, 0, 0});
+      return false; 
+    }
+
+    // The touch resistance needs X, Y is only converted if the pen is down
+    int z2 = _bus->transfer(CMD_READ_Z2);
+    tp.zValue = z1 + 4095 - z2;
+    tp.xValue = _readAxis(CMD_READ_X, true);
+    tp.rTouch = _pressure.resistance(tp.xValue, z1, z2);
+    if (! _pressure.update(tp.rTouch))
+    { 
+      _bus->deselect();
+      _sampleCycles = gpioCycles() - t0;
+      XPT2046_METRIC(_metrics.rejectedPressure++; _metrics.addSample(_sampleCycles));
+      if (_traceOut) _recordTrace(false, tp);
+      return false; 
+    }
+    tp.yValue = _readAxis(CMD_READ_Y, true);
+    _bus->deselect();
+    _sampleCycles = gpioCycles() - t0;
+    XPT2046_METRIC(_metrics.addSample(_sampleCycles));
+    if (_traceOut) _recordTrace(true, tp);
+    _mapToScreen(tp);
+    return true;
+}
 
-    if(tp.zValue < 100) { return false; }
 
-    tp.xValue = _readSPI(CMD_READ_X);
-    tp.yValue = _readSPI(CMD_READ_Y & ~((byte)1));
-    digitalWrite(_csPin, HIGH);
+/**
+ * Maps the raw values of tp to screen coordinates. The rotation 
+ * is folded into the transform, which is rebuilt when the rotation 
+ * of the display has changed since the last call. 
+ * The origin is always the top left corner.
+ */
+void XPT2046_Bitbang::_mapToScreen(TouchPoint &tp)
+{
+    uint8_t rotation = _lcd.getRotation();
+    portENTER_CRITICAL(&_xformMux);
+    if (rotation != _screen.rotation) _screen = _screenTransform(rotation);
+    ScreenTransform st = _screen;
+    portEXIT_CRITICAL(&_xformMux);
 
-    int x = map((int)tp.xValue, (int)_cal.touchMin.xValue, (int)_cal.touchMax.xValue, _cal.touchMin.x, _cal.touchMax.x); 
-    int y = map((int)tp.yValue, (int)_cal.touchMin.yValue, (int)_cal.touchMax.yValue, _cal.touchMin.y, _cal.touchMax.y);
+    int x, y;
+    applyAffineTransform(st.xform, tp.xValue, tp.yValue, x, y);
 
     // Limit the coordinates to the screen dimensions
-    x = x < 0 ? 0 : x;
-    x = x > TFT_WIDTH ? TFT_WIDTH : x;
-    y = y < 0 ? 0 : y;
-    y = y > TFT_HEIGHT ? TFT_HEIGHT : y;
-
-    // Calculates the coordinates taking into account the screen  
-    // orientation. The origin is always the top left corner.   
-    switch (_rotation)
+    tp.x = std::min(std::max(x, 0), st.xMax);
+    tp.y = std::min(std::max(y, 0), st.yMax);
+
+    //log_i("rot = %d, x = %d, y = %d, xValue = %d, yValue = %d", rotation, tp.x, tp.y, tp.xValue, tp.yValue);
+}
+
+
+/**
+ * Records the raw values of all samples taken by getTouch() while
+ * the pen is down and of the first sample after it went up into out,
+ * e.g. a file on the SD card or Serial (see XPT2046_Trace.h).
+ * The records are written by the task calling getTouch(), so a file 
+ * may only be closed after stopTrace() and the sampling task stopped.
+ */
+void XPT2046_Bitbang::startTrace(Print &out)
+{
+    uint8_t header[XPT2046_TRACE_HEADER_SIZE];
+    out.write(header, packTraceHeader(header));
+    _msTrace = millis();
+    _traceWasDown = false;
+    _traceOut = &out;
+}
+
+
+void XPT2046_Bitbang::stopTrace()
+{
+    _traceOut = nullptr;
+}
+
+
+void XPT2046_Bitbang::_recordTrace(bool penDown, const TouchPoint &tp)
+{
+    Print *out = _traceOut;
+    if (! out || ! (penDown || _traceWasDown)) return;
+    _traceWasDown = penDown;
+    uint8_t buf[XPT2046_TRACE_RECORD_SIZE];
+    TraceRecord r = {millis(), penDown, (uint16_t)tp.xValue, (uint16_t)tp.yValue, (uint16_t)tp.zValue};
+    packTraceRecord(r, _msTrace, buf);
+    _msTrace = r.ms;
+    out->write(buf, sizeof(buf));
+}
+
+
+/**
+ * Feeds a recorded trace through the current calibration into the gesture 
+ * recognizer and the subscribed handlers, or into the calibration if one 
+ * is in progress. With realTime = false the records follow each other 
+ * without delay, the timestamps are taken from the trace, so the result 
+ * does not depend on the speed of the replay.
+ * Returns the number of records replayed.
+ */
+size_t XPT2046_Bitbang::replayTrace(Stream &in, bool realTime)
+{
+    uint8_t buf[XPT2046_TRACE_HEADER_SIZE > XPT2046_TRACE_RECORD_SIZE ? XPT2046_TRACE_HEADER_SIZE : XPT2046_TRACE_RECORD_SIZE];
+    size_t headerSize, recordSize, n = 0;
+
+    if (in.readBytes(buf, XPT2046_TRACE_HEADER_SIZE) != XPT2046_TRACE_HEADER_SIZE
+        || ! unpackTraceHeader(buf, XPT2046_TRACE_HEADER_SIZE, headerSize, recordSize))
     {
-        case 0: 
-            // LANDSCAPE_USB_RIGHT
-            tp.x = (uint16_t)x;
-            tp.y = (uint16_t)y;
-        break;
-
-        case 1:
-            // PORTRAIT_USB_UP
-            tp.x = (uint16_t)y;
-            tp.y = (uint16_t)(TFT_WIDTH - x);
-        break;
-
-        case 2:
-             // LANDSCAPE_USB_LEFT
-            tp.x = (uint16_t)(TFT_WIDTH - x);
-            tp.y = (uint16_t)(TFT_HEIGHT - y);
-        break;
-
-        case 3:
-            // PORTRAIT_USB_DOWN
-            tp.x = (uint16_t)(TFT_HEIGHT - y);
-            tp.y = (uint16_t)x;
-        break;
+      log_e("==> not a touch trace");
+      return 0;
     }
+    for (size_t i = XPT2046_TRACE_HEADER_SIZE; i < headerSize; i++) in.read();
 
-    //log_i("rot = %d, x = %d, y = %d, xValue = %d, yValue = %d", _rotation, tp.x, tp.y, tp.xValue, tp.yValue);
-    return true;
+    TraceRecord r;
+    uint32_t ms = millis();
+    while (in.readBytes(buf, XPT2046_TRACE_RECORD_SIZE) == XPT2046_TRACE_RECORD_SIZE)
+    {
+      for (size_t i = XPT2046_TRACE_RECORD_SIZE; i < recordSize; i++) in.read();
+      unpackTraceRecord(buf, ms, r);
+      if (realTime) delay(r.ms - ms);
+      ms = r.ms;
+
+      TouchSample sample = {{0, 0, r.xValue, r.yValue, r.zValue, 0}, r.ms, r.penDown};
+      if (r.penDown) _mapToScreen(sample.tp);
+      if (_calSM.isRunning()) _calibrationStep(sample.penDown, sample.tp, sample.ms);
+      else _processSample(sample);
+      n++;
+    }
+    return n;
 }
 
 
@@ -308,7 +899,7 @@ uint16_t XPT2046_Bitbang::_readSPI(byte command)
  */
   bool XPT2046_Bitbang::getTouch() 
   {
-    TouchPoint tp = {0, 0, 0, 0, 0};
+    TouchPoint tp = {0, 0, 0, 0, 0, 0};
     return getTouch(tp);
   }
 
@@ -323,117 +914,270 @@ uint16_t XPT2046_Bitbang::_readSPI(byte command)
   }
 
 
-/**                                   
- *                                 up
- *  Determines the swipe          \   /
- *  direction relative to     left  o  right
- *  the starting point            /   \
- *                                 down 
+/**
+ * Samples the touchpad, dispatches the detected events and sleeps 
+ * until the next sample is due. While the pen is down the touchpad 
+ * is sampled every msActive, when it is up the period doubles with 
+ * each sample up to the latency budget (see setPollingRate()). With
+ * IRQ pin loop() waits for PENIRQ instead, at most the latency budget.
+ * If PENIRQ is already low but the touch is too light, it backs off
+ * like without IRQ pin. When the sampling task is running, the queued samples 
+ * are processed instead and loop() returns without delay.
  */
-  int XPT2046_Bitbang::_getSwipeDir(TouchPoint tpPenDown, TouchPoint tpPenUp)
+  void XPT2046_Bitbang::loop()
   {
-    // -1 = not swiped, 1 = right, 2 = up, 3 = left, 4 = down;
-    float dx = tpPenUp.x - tpPenDown.x;
-    float dy = tpPenUp.y - tpPenDown.y;
-    int result;
-    if (abs(dx) < _minSwipeDiff && abs(dy) < _minSwipeDiff) result = 0;
+    if (_task)
+    {
+      TouchSample sample;
+      while (_queue.pop(sample)) _processSample(sample);
+      return;
+    }
+    uint32_t us = micros();
+    TouchSample sample;
+    sample.penDown = getTouch(sample.tp);
+    sample.ms = millis();
+    _processSample(sample);
+    uint32_t msPeriod = _nextPeriod(sample.penDown);
+    uint32_t usBusy = micros() - us;
 
-    else if (((dx > 0 && dy > 0) || (dx > 0 && dy < 0)) && fabs(dx/dy) > 1)
-      result = 1;
+    if (! sample.penDown && _irqPin >= 0 && ! isPenDown()) waitForTouch(_msLatencyBudget);
+    else if (msPeriod > usBusy / 1000) delay(msPeriod - usBusy / 1000);
+    _countIdle(usBusy, micros() - us - usBusy);
+  }
 
-    else if (((dx > 0 && dy < 0) || (dx < 0 && dy < 0)) && fabs(dx/dy) < 1)
-      result = 2;
 
-    else if (((dx < 0 && dy < 0) || (dx < 0 && dy > 0)) && fabs(dx/dy) > 1)
-      result = 3;
+/**
+ * Sets the sample period while the pen is down and the longest period 
+ * while the pen is up, which is also the longest time until a touch 
+ * is detected.
+ */
+void XPT2046_Bitbang::setPollingRate(uint32_t msActive, uint32_t msLatencyBudget)
+{
+    _msActivePeriod  = msActive > 0 ? msActive : 1;
+    _msLatencyBudget = std::max(msLatencyBudget, _msActivePeriod);
+    _msPeriod = _msActivePeriod;
+}
 
-    else if (((dx < 0 && dy > 0) || (dx > 0 && dy > 0)) && fabs(dx/dy) < 1)
-      result = 4;
 
-    else result = -1;
-    //log_i("swipe result = %d", result);
-    return result;
-  }
+/**
+ * Samples per second taken by loop() or the sampling task,
+ * measured over the last second
+ */
+uint32_t XPT2046_Bitbang::getSampleRate()
+{
+    return _sampleRate;
+}
 
-  void XPT2046_Bitbang::loop()
+
+/**
+ * Share of the time loop() or the sampling task spent 
+ * sleeping during the last second in percent
+ */
+uint8_t XPT2046_Bitbang::getIdleCpuPercent()
+{
+    return _idlePercent;
+}
+
+
+/**
+ * Returns the period until the next sample: the active period 
+ * while the pen is down, otherwise the doubled current period 
+ * limited to the latency budget
+ */
+uint32_t XPT2046_Bitbang::_nextPeriod(bool penDown)
+{
+    _msPeriod = penDown ? _msActivePeriod : std::min(_msPeriod * 2, _msLatencyBudget);
+    return _msPeriod;
+}
+
+
+/**
+ * Accumulates the busy and idle time of one iteration of 
+ * loop() or the sampling task and updates the counters 
+ * once per second
+ */
+void XPT2046_Bitbang::_countIdle(uint32_t usBusy, uint32_t usIdle, bool sampled)
+{
+    XPT2046_METRIC(_metrics.loops++);
+    _usWindow += usBusy + usIdle;
+    _usIdle   += usIdle;
+    if (sampled) _windowSamples++;
+    if (_usWindow < 1000000UL) return;
+    _idlePercent = (uint8_t)((uint64_t)_usIdle * 100 / _usWindow);
+    _sampleRate  = (uint32_t)((uint64_t)_windowSamples * 1000000ULL / _usWindow);
+    _usWindow = _usIdle = _windowSamples = 0;
+}
+
+
+/**
+ * Feeds the sample to the gesture recognizer and dispatches the
+ * resulting events. Swipes and long touches are reported while 
+ * the pen is still down (see XPT2046_Gesture.h).
+ */
+  void XPT2046_Bitbang::_processSample(const TouchSample &sample)
   {
-    if (getTouch(_tp)) 
-    { // pen is down
-      if (_msPenDown == 0) 
-      {
-      _msPenDown = millis(); // save time and position as soon as the pen goes down
-      _tpPenDown = _tp;
-      }
-      else
-      {
-      _msPenUp = millis(); // save time and position as long as the pen is touching, 
-      _tpPenUp = _tp;      // so the last time and position are saved when the pen moves upwards
-      } 
-    } 
-    else 
-    { // pen is up
-      if (_msPenUp > 0)
-      {
-        _msTouchDuration = _msPenUp - _msPenDown;
-        _swipeDir = _getSwipeDir(_tpPenDown, _tpPenUp);
-        //log_i("touchDuration = %d",_msTouchDuration);
-        if (_msTouchDuration > _msLongTouchMinDuration)
-        {
-          switch(_swipeDir)
-          {
-            case 0:
-              if (_onLongTouch) _onLongTouch(_tpPenUp.x, _tpPenUp.y);
-            break;
-
-            case 1:
-              if (_onSwipeRight) _onSwipeRight(_tpPenUp.x, _tpPenUp.y);
-            break;
-            
-            case 2:
-              if (_onSwipeUp) _onSwipeUp(_tpPenUp.x, _tpPenUp.y);
-            break;
-
-            case 3:
-              if (_onSwipeLeft) _onSwipeLeft(_tpPenUp.x, _tpPenUp.y);
-            break;
-
-            case 4:
-              if (_onSwipeDown) _onSwipeDown(_tpPenUp.x, _tpPenUp.y);
-            break;
-          }
-          
-        }
-        else if (_msTouchDuration > _msShortTouchMinDuration)
-        {
-          if (_onShortTouch) _onShortTouch(_tpPenUp.x, _tpPenUp.y);
-        }
-        _msPenDown = 0;
-        _msPenUp = 0;
-        _tpPenDown.x = 0;
-        _tpPenDown.y = 0;
-        _tpPenUp.x = 0;
-        _tpPenUp.y = 0;
+    TouchEvent events[XPT2046_MAX_EVENTS];
+    int n = _gesture.feed(sample.penDown, sample.tp.x, sample.tp.y, sample.ms, events);
+    for (int i = 0; i < n; i++) 
+    {
+      XPT2046_METRIC(_metrics.events[events[i].type]++; _metrics.handlers += _dispatcher.subscribers(events[i].type));
+      _dispatcher.dispatch(events[i]);
+    }
+  }
+
+
+/**
+ * Starts a task which samples the touchpad every msPeriod while the pen 
+ * is down and pushes the samples into a lock-free queue. While the pen is
+ * up the task backs off like loop(). The task runs on core 0 by default, 
+ * the Arduino loop runs on core 1. Only samples with the pen down and 
+ * the first sample after the pen went up are queued.
+ * While the task is running, the samples must be consumed either by 
+ * loop() or by readSample(), not by both, and getTouch() must not be 
+ * called by the application.
+ */
+bool XPT2046_Bitbang::startSamplingTask(uint32_t msPeriod, int core)
+{
+    if (_task) return true;
+    setPollingRate(msPeriod, _msLatencyBudget);
+    _taskRunning = true;
+    if (xTaskCreatePinnedToCore(_samplingTask, "touch", 3072, this, 2, (TaskHandle_t *)&_task, 
+                                core < 0 ? tskNO_AFFINITY : core) != pdPASS)
+    {
+      _taskRunning = false;
+      _task = nullptr;
+      log_e("==> failed to create the sampling task");
+      return false;
+    }
+    return true;
+}
 
+
+/**
+ * Stops the sampling task after the current sample is complete
+ */
+void XPT2046_Bitbang::stopSamplingTask()
+{
+    _taskRunning = false;
+    while (_task) delay(1);
+}
+
+
+/**
+ * Returns the oldest queued sample without blocking
+ */
+bool XPT2046_Bitbang::readSample(TouchSample &sample)
+{
+    return _queue.pop(sample);
+}
+
+
+/**
+ * Number of samples lost because the queue was full
+ */
+uint32_t XPT2046_Bitbang::getDroppedSamples()
+{
+    return _queue.dropped();
+}
+
+
+void XPT2046_Bitbang::_samplingTask(void *arg)
+{
+    XPT2046_Bitbang *self = static_cast<XPT2046_Bitbang *>(arg);
+    TickType_t lastWake = xTaskGetTickCount();
+    bool wasDown = false;
+    TouchSample sample;
+
+    while (self->_taskRunning)
+    {
+      uint32_t us = micros();
+      if (! wasDown && self->_irqPin >= 0 && ! self->isPenDown())
+      {
+        self->waitForTouch(self->_msLatencyBudget);
+        lastWake = xTaskGetTickCount();
+        self->_countIdle(0, micros() - us, false);
+        continue;
       }
+      sample.penDown = self->getTouch(sample.tp);
+      sample.ms = millis();
+      if (sample.penDown || wasDown) self->_queue.push(sample);
+      wasDown = sample.penDown;
+      uint32_t usBusy = micros() - us;
+      vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(self->_nextPeriod(sample.penDown)));
+      self->_countIdle(usBusy, micros() - us - usBusy);
     }
-    delay(10);
-  }
+    self->_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+
+/**
+ * Registers fn to be called with ctx for each event of the given type.
+ * Returns false if XPT2046_MAX_SUBSCRIBERS handlers are already registered.
+ */
+bool XPT2046_Bitbang::subscribe(TouchEventType type, TouchHandler fn, void *ctx)
+{ return _dispatcher.subscribe(type, fn, ctx); }
+
+bool XPT2046_Bitbang::unsubscribe(TouchEventType type, TouchHandler fn, void *ctx)
+{ return _dispatcher.unsubscribe(type, fn, ctx); }
+
+
+/**
+ * The callbacks installed with add...Cb() are subscribed through
+ * these trampolines, ctx points to the slot holding the callback.
+ * Installing another callback replaces the previous one in its 
+ * place among the subscribers, nullptr removes it.
+ */
+void XPT2046_Bitbang::_callLegacy(void *ctx, const TouchEvent &ev)
+{
+    Callback cb = *static_cast<Callback *>(ctx);
+    cb(ev.x, ev.y);
+}
+
+void XPT2046_Bitbang::_callEvent(void *ctx, const TouchEvent &ev)
+{
+    EventCallback cb = *static_cast<EventCallback *>(ctx);
+    cb(ev);
+}
+
+void XPT2046_Bitbang::_setCallback(TouchEventType type, Callback cb)
+{
+    if (_legacyCb[type] && ! cb) _dispatcher.unsubscribe(type, _callLegacy, &_legacyCb[type]);
+    if (! _legacyCb[type] && cb && ! _dispatcher.subscribe(type, _callLegacy, &_legacyCb[type])) return;
+    _legacyCb[type] = cb;
+}
+
+void XPT2046_Bitbang::_setCallback(TouchEventType type, EventCallback cb)
+{
+    if (_eventCb[type] && ! cb) _dispatcher.unsubscribe(type, _callEvent, &_eventCb[type]);
+    if (! _eventCb[type] && cb && ! _dispatcher.subscribe(type, _callEvent, &_eventCb[type])) return;
+    _eventCb[type] = cb;
+}
 
 
 void XPT2046_Bitbang::addShortTouchCb(Callback cb)
-{ _onShortTouch = cb; }
+{ _setCallback(TOUCH_SHORT, cb); }
 
 void XPT2046_Bitbang::addLongTouchCb(Callback cb)
-{ _onLongTouch = cb; }
+{ _setCallback(TOUCH_LONG, cb); }
 
 void XPT2046_Bitbang::addSwipeLeftCb(Callback cb)
-{ _onSwipeLeft = cb; }
+{ _setCallback(TOUCH_SWIPE_LEFT, cb); }
 
 void XPT2046_Bitbang::addSwipeRightCb(Callback cb)
-{ _onSwipeRight = cb; }
+{ _setCallback(TOUCH_SWIPE_RIGHT, cb); }
 
 void XPT2046_Bitbang::addSwipeUpCb(Callback cb)
-{ _onSwipeUp = cb; }
+{ _setCallback(TOUCH_SWIPE_UP, cb); }
 
 void XPT2046_Bitbang::addSwipeDownCb(Callback cb)
-{ _onSwipeDown = cb; }
\ No newline at end of file
+{ _setCallback(TOUCH_SWIPE_DOWN, cb); }
+
+void XPT2046_Bitbang::addPenDownCb(EventCallback cb)
+{ _setCallback(TOUCH_PEN_DOWN, cb); }
+
+void XPT2046_Bitbang::addMoveCb(EventCallback cb)
+{ _setCallback(TOUCH_MOVE, cb); }
+
+void XPT2046_Bitbang::addPenUpCb(EventCallback cb)
+{ _setCallback(TOUCH_PEN_UP, cb); }
@@ -12,6 +12,9 @@
  *              misoPin     ESP32 pin MISO
  *              clkPin      ESP32 pin CLK
  *              csPin       ESP32 pin CS
+ *          or
+ *              &lcd        reference to LGFX display
+ *              &bus        reference to a XPT2046_Transport backend (see XPT2046_Transport.h)
  * 
  * References   https://registry.platformio.org/libraries/nitek/XPT2046_Bitbang_Slim
  *              https://github.com/lovyan03/LovyanGFX
@@ -23,26 +26,42 @@
 #include <Preferences.h>
 #include <LovyanGFX.hpp>
 #include "lgfx_ESP32_2432S028.h"
+#include "XPT2046_Transport.h"
+#include "XPT2046_EventQueue.h"
+#include "XPT2046_Filter.h"
+#include "XPT2046_Calibration.h"
+#include "XPT2046_Pressure.h"
+#include "XPT2046_Gesture.h"
+#include "XPT2046_Dispatch.h"
+#include "XPT2046_Regions.h"
+#include "XPT2046_Metrics.h"
+#include "XPT2046_Trace.h"
 
 #define CMD_READ_X   0x91 // Command for XPT2046 to read X position
 #define CMD_READ_Y   0xD1 // Command for XPT2046 to read Y position
 #define CMD_READ_Z1  0xB1 // Command for XPT2046 to read Z1 position
 #define CMD_READ_Z2  0xC1 // Command for XPT2046 to read Z2 position
 
-#define DELAY 5
+#ifndef XPT2046_ACTIVE_PERIOD_MS
+  #define XPT2046_ACTIVE_PERIOD_MS  10  // sample period while the pen is down
+#endif
+#ifndef XPT2046_LATENCY_BUDGET_MS
+  #define XPT2046_LATENCY_BUDGET_MS 100 // longest sample period while the pen is up
+#endif
 
-using Callback = void (*)(int x, int y);
+#ifndef XPT2046_QUEUE_SIZE
+  #define XPT2046_QUEUE_SIZE 32 // capacity of the sample queue, must be a power of 2
+#endif
 
-using TouchPoint = struct tpnt
-{
-    int x,       y,               // screen coordinates
-        xValue,  yValue, zValue;  // raw values read from touchpad
-};
 
-using TouchCalibration = struct tcal
+using Callback = void (*)(int x, int y);
+using EventCallback = void (*)(const TouchEvent &ev);
+
+using TouchSample = struct tsmp
 {
-    TouchPoint touchMin; 
-    TouchPoint touchMax;
+    TouchPoint tp;        // coordinates, valid if penDown
+    uint32_t   ms;        // time of the sample in ms
+    bool       penDown;   // false for the first sample after the pen went up
 };
 
 
@@ -50,18 +69,47 @@ class XPT2046_Bitbang
 {
     public:
         XPT2046_Bitbang(LGFX &lcd, uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin);
+        XPT2046_Bitbang(LGFX &lcd, XPT2046_Transport &bus);
         void begin();
+        void setClockFrequency(uint32_t hz);
+        void setPlateResistance(uint16_t rxPlate);
+        void setPressureThresholds(uint16_t rPenDown, uint16_t rPenUp);
+        uint32_t getSampleCycles();
+        void benchmarkTransport(int nbrSamples = 1000);
+        void useIrq(uint8_t irqPin);
+        bool isPenDown();
+        bool waitForTouch(uint32_t msTimeout, bool lightSleep = false);
         void loop();
+        void setPollingRate(uint32_t msActive, uint32_t msLatencyBudget);
+        uint32_t getSampleRate();
+        uint8_t getIdleCpuPercent();
+        bool startSamplingTask(uint32_t msPeriod = 10, int core = 0);
+        void stopSamplingTask();
+        bool readSample(TouchSample &sample);
+        uint32_t getDroppedSamples();
         bool getTouch();
         bool getTouch(TouchPoint& tp);
         bool getTouch(int &xScreen, int &yScreen);
         void useCalibrationPoints(TouchPoint tp[], int nbrTouches);
+        void useCalibrationPoints(TouchPoint tp[], int nbrPoints, int nbrTouches);
+        void startCalibration(TouchPoint tp[], int nbrPoints, int nbrTouches);
+        bool calibrationTick();
+        bool isCalibrating();
+        int  getCalibrationConfidence(int point);
+        float getCalibrationResidual();
         bool isCalibrationDataAvailable();
-        void clearCalibrationData();
-        void saveCalibrationData();
-        void erasePreferences();
+        void clearCalibrationData(bool restart = false);
+        void saveCalibrationData(bool restart = false);
+        void erasePreferences(bool restart = false);
         bool recallCalibrationData();
         void printCalibrationData();
+        void printMetrics();
+#if XPT2046_METRICS
+        const TouchMetrics &getMetrics() const { return _metrics; }
+#endif
+        void startTrace(Print &out);
+        void stopTrace();
+        size_t replayTrace(Stream &in, bool realTime = false);
         bool touchedAt(int x, int y, int x0, int y0, int dx, int dy);
 
         void addShortTouchCb(Callback cb);
@@ -70,36 +118,84 @@ class XPT2046_Bitbang
         void addSwipeRightCb(Callback cb);
         void addSwipeUpCb(Callback cb);
         void addSwipeDownCb(Callback cb);
+        void addPenDownCb(EventCallback cb);
+        void addMoveCb(EventCallback cb);
+        void addPenUpCb(EventCallback cb);
+        bool subscribe(TouchEventType type, TouchHandler fn, void *ctx = nullptr);
+        bool unsubscribe(TouchEventType type, TouchHandler fn, void *ctx = nullptr);
 
     private:
         LGFX&   _lcd;
-        uint8_t _rotation;
-        uint8_t _mosiPin;
-        uint8_t _misoPin;
-        uint8_t _clkPin;
-        uint8_t _csPin;
-        uint32_t _msPenDown;
-        uint32_t _msPenUp;
-        uint32_t _msTouchDuration;
-        const uint32_t long _msLongTouchMinDuration  = 280UL;
-        const uint32_t long _msShortTouchMinDuration = 35UL;
-        TouchPoint _tp;
-        TouchPoint _tpPenDown;
-        TouchPoint _tpPenUp;
-        const int _minSwipeDiff = 20;
-        int _swipeDir;
+        XPT2046_BitbangTransport _bitbangBus;
+        XPT2046_Transport *_bus;
+        uint32_t _sampleCycles = 0;
+        PressureDetector _pressure;
+#if XPT2046_METRICS
+        TouchMetrics _metrics = {};
+#endif
+        int8_t   _irqPin = -1;
+        GpioPin  _irq;
+        volatile TaskHandle_t _waitingTask = nullptr;
+        static void IRAM_ATTR _onPenIrq(void *arg);
+        EventQueue<TouchSample, XPT2046_QUEUE_SIZE> _queue;
+        volatile TaskHandle_t _task = nullptr;
+        volatile bool _taskRunning = false;
+        uint32_t _msActivePeriod  = XPT2046_ACTIVE_PERIOD_MS;
+        uint32_t _msLatencyBudget = XPT2046_LATENCY_BUDGET_MS;
+        uint32_t _msPeriod = XPT2046_ACTIVE_PERIOD_MS;
+        uint32_t _usWindow = 0;
+        uint32_t _usIdle = 0;
+        uint32_t _windowSamples = 0;
+        volatile uint32_t _sampleRate = 0;
+        volatile uint8_t  _idlePercent = 0;
+        uint32_t _nextPeriod(bool penDown);
+        void     _countIdle(uint32_t usBusy, uint32_t usIdle, bool sampled = true);
+        static void _samplingTask(void *arg);
+        void _processSample(const TouchSample &sample);
+        uint16_t _readAxis(uint8_t command, bool powerDown);
+        void _mapToScreen(TouchPoint &tp);
+        Print   *volatile _traceOut = nullptr;
+        uint32_t _msTrace = 0;
+        bool     _traceWasDown = false;
+        void     _recordTrace(bool penDown, const TouchPoint &tp);
+        bool     _calibrationStep(bool penDown, const TouchPoint &p, uint32_t ms);
+        GestureRecognizer _gesture;
         TouchCalibration _cal;
-        int      _getSwipeDir(TouchPoint tpPenDown, TouchPoint tpPenUp);
-        void     _writeSPI(byte command);
-        uint16_t _readSPI(byte command);
+        CalibrationStateMachine _calSM;
+        TouchCalibration _storedCal;  // copy of the calibration in the NVS
+        int8_t   _calStored = -1;     // -1 not read yet, 0 no data, 1 data available
+        AffineTransform  _calXform;   // raw values -> landscape coordinates
+        using ScreenTransform = struct strf
+        {
+            AffineTransform xform;   // raw values -> screen coordinates in the current rotation
+            int      xMax, yMax;
+            uint8_t  rotation;
+        };
+        ScreenTransform  _screen;
+        portMUX_TYPE     _xformMux = portMUX_INITIALIZER_UNLOCKED;
+        ScreenTransform  _screenTransform(uint8_t rotation);
+        enum { PERSIST_NONE, PERSIST_SAVE, PERSIST_CLEAR };
+        uint8_t  _persistOp = PERSIST_NONE;
+        TouchCalibration _persistCal;
+        volatile bool _persistBusy = false;
+        void     _persist(uint8_t op);
+        bool     _doPersist();
+        void     _waitForPersist();
+        static void _persistTaskFn(void *arg);
+        float    _calResidual = 0.0f;
+        void     _useDefaultCalibration();
+        void     _loadCalibration();
+        bool     _writeCalibration(const TouchCalibration &cal);
+        bool     _updateTransform();
         Preferences _prefs;
 
-        Callback _onShortTouch = nullptr;
-        Callback _onLongTouch  = nullptr;
-        Callback _onSwipeLeft  = nullptr;
-        Callback _onSwipeRight = nullptr;
-        Callback _onSwipeUp    = nullptr;
-        Callback _onSwipeDown  = nullptr;
+        TouchDispatcher _dispatcher;
+        Callback      _legacyCb[TOUCH_EVENT_TYPES] = {};
+        EventCallback _eventCb[TOUCH_EVENT_TYPES]  = {};
+        static void _callLegacy(void *ctx, const TouchEvent &ev);
+        static void _callEvent(void *ctx, const TouchEvent &ev);
+        void _setCallback(TouchEventType type, Callback cb);
+        void _setCallback(TouchEventType type, EventCallback cb);
         void _crosshair(TouchPoint p, int s, uint16_t color);
 };
 
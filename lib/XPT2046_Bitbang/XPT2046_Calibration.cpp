@@ -0,0 +1,410 @@
+/**
+ * File         XPT2046_Calibration.cpp
+ *
+ * Purpose      Least squares fit of the affine calibration model
+ *              (see XPT2046_Calibration.h)
+ */
+
+#include <math.h>
+#include "XPT2046_Calibration.h"
+
+static int32_t toFix(double v)
+{
+    return (int32_t)lround(v * XPT2046_FIX_ONE);
+}
+
+
+/**
+ * Fits scale and offset of each axis to the first 2 points.
+ * Returns false if the raw values of the points coincide.
+ */
+static bool fitTwoPoints(const TouchPoint &p0, const TouchPoint &p1, double m[6])
+{
+    if (p1.xValue == p0.xValue || p1.yValue == p0.yValue) return false;
+    m[0] = (double)(p1.x - p0.x) / (p1.xValue - p0.xValue);
+    m[1] = 0.0;
+    m[2] = p0.x - m[0] * p0.xValue;
+    m[3] = 0.0;
+    m[4] = (double)(p1.y - p0.y) / (p1.yValue - p0.yValue);
+    m[5] = p0.y - m[4] * p0.yValue;
+    return true;
+}
+
+
+/**
+ * Solves the normal equations of the least squares problem for
+ * x and y. The raw values are centered to keep the system well
+ * conditioned. Returns false if the points lie on a line.
+ */
+static bool fitLeastSquares(const TouchCalibration &cal, double m[6])
+{
+    const int n = cal.nbrPoints;
+    double mx = 0, my = 0, mu = 0, mv = 0;
+    for (int i = 0; i < n; i++)
+    {
+        mx += cal.point[i].xValue;
+        my += cal.point[i].yValue;
+        mu += cal.point[i].x;
+        mv += cal.point[i].y;
+    }
+    mx /= n; my /= n; mu /= n; mv /= n;
+
+    double sxx = 0, sxy = 0, syy = 0, sxu = 0, syu = 0, sxv = 0, syv = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double dx = cal.point[i].xValue - mx;
+        double dy = cal.point[i].yValue - my;
+        double du = cal.point[i].x - mu;
+        double dv = cal.point[i].y - mv;
+        sxx += dx * dx; sxy += dx * dy; syy += dy * dy;
+        sxu += dx * du; syu += dy * du;
+        sxv += dx * dv; syv += dy * dv;
+    }
+
+    double det = sxx * syy - sxy * sxy;
+    if (fabs(det) <= 1e-6 * sxx * syy) return false;
+
+    m[0] = (sxu * syy - syu * sxy) / det;
+    m[1] = (syu * sxx - sxu * sxy) / det;
+    m[2] = mu - m[0] * mx - m[1] * my;
+    m[3] = (sxv * syy - syv * sxy) / det;
+    m[4] = (syv * sxx - sxv * sxy) / det;
+    m[5] = mv - m[3] * mx - m[4] * my;
+    return true;
+}
+
+
+/**
+ * Computes the affine transform from the calibration points and
+ * optionally the RMS distance in pixels between the targets and
+ * the transformed raw values. Returns false if no transform can
+ * be computed, t is left unchanged in that case.
+ */
+bool fitAffineTransform(const TouchCalibration &cal, AffineTransform &t, float *rmsResidual)
+{
+    double m[6];
+    int n = cal.nbrPoints;
+    if (n < 2 || n > XPT2046_MAX_CAL_POINTS) return false;
+
+    if (n < 3 || ! fitLeastSquares(cal, m))
+    {
+        if (! fitTwoPoints(cal.point[0], cal.point[1], m)) return false;
+        n = 2;
+    }
+
+    t.a = toFix(m[0]); t.b = toFix(m[1]); t.c = toFix(m[2]);
+    t.d = toFix(m[3]); t.e = toFix(m[4]); t.f = toFix(m[5]);
+
+    if (rmsResidual)
+    {
+        double sum = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const TouchPoint &p = cal.point[i];
+            double ex = m[0] * p.xValue + m[1] * p.yValue + m[2] - p.x;
+            double ey = m[3] * p.xValue + m[4] * p.yValue + m[5] - p.y;
+            sum += ex * ex + ey * ey;
+        }
+        *rmsResidual = (float)sqrt(sum / n);
+    }
+    return true;
+}
+
+
+/**
+ * Composes the transform t, which maps to landscape coordinates 
+ * 0..width, 0..height (rotation 0), with the screen rotation:
+ *   0  LANDSCAPE_USB_RIGHT   X = x           Y = y
+ *   1  PORTRAIT_USB_UP       X = y           Y = width - x
+ *   2  LANDSCAPE_USB_LEFT    X = width - x   Y = height - y
+ *   3  PORTRAIT_USB_DOWN     X = height - y  Y = x
+ */
+AffineTransform rotateAffineTransform(const AffineTransform &t, uint8_t rotation, int width, int height)
+{
+    const int32_t w = (int32_t)width  << XPT2046_FIX_SHIFT;
+    const int32_t h = (int32_t)height << XPT2046_FIX_SHIFT;
+
+    switch (rotation & 3)
+    {
+        case 1:  return AffineTransform {  t.d,  t.e,  t.f,     -t.a, -t.b, w - t.c };
+        case 2:  return AffineTransform { -t.a, -t.b, w - t.c,  -t.d, -t.e, h - t.f };
+        case 3:  return AffineTransform { -t.d, -t.e, h - t.f,   t.a,  t.b,  t.c    };
+        default: return t;
+    }
+}
+
+
+/**
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320).
+ * Pass the previous result as crc to continue a calculation.
+ */
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+    }
+    return ~crc;
+}
+
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+static uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+
+/**
+ * Serializes the calibration into buf and returns the
+ * size of the blob or 0 if buf is too small
+ */
+size_t packCalibration(const TouchCalibration &cal, uint8_t *buf, size_t bufSize)
+{
+    const int n = cal.nbrPoints;
+    const size_t payloadSize = 4 + 20 * n;
+    const size_t size = XPT2046_CAL_HEADER_SIZE + payloadSize + 4;
+    if (n < 2 || n > XPT2046_MAX_CAL_POINTS || size > bufSize) return 0;
+
+    put16(buf, XPT2046_CAL_MAGIC);
+    buf[2] = XPT2046_CAL_VERSION;
+    buf[3] = XPT2046_CAL_HEADER_SIZE;
+    put16(buf + 4, payloadSize);
+    put16(buf + 6, 0);
+
+    uint8_t *p = buf + XPT2046_CAL_HEADER_SIZE;
+    put32(p, n); 
+    p += 4;
+    for (int i = 0; i < n; i++, p += 20)
+    {
+        put32(p,      cal.point[i].x);
+        put32(p +  4, cal.point[i].y);
+        put32(p +  8, cal.point[i].xValue);
+        put32(p + 12, cal.point[i].yValue);
+        put32(p + 16, cal.point[i].zValue);
+    }
+    put32(p, crc32(buf, size - 4));
+    return size;
+}
+
+
+/**
+ * Checks magic, sizes and CRC of the blob and extracts the 
+ * calibration points. Returns false if the blob is invalid, 
+ * cal is left unchanged in that case.
+ */
+bool unpackCalibration(const uint8_t *buf, size_t len, TouchCalibration &cal)
+{
+    if (len < XPT2046_CAL_HEADER_SIZE + 4 + 4) return false;
+    if (get16(buf) != XPT2046_CAL_MAGIC) return false;
+
+    const size_t headerSize  = buf[3];
+    const size_t payloadSize = get16(buf + 4);
+    const size_t size = headerSize + payloadSize + 4;
+    if (headerSize < XPT2046_CAL_HEADER_SIZE || size > len) return false;
+    if (crc32(buf, size - 4) != get32(buf + size - 4)) return false;
+
+    const uint8_t *p = buf + headerSize;
+    int32_t n = (int32_t)get32(p);
+    if (n < 2 || n > XPT2046_MAX_CAL_POINTS || payloadSize < 4 + 20 * (size_t)n) return false;
+
+    cal.nbrPoints = n;
+    p += 4;
+    for (int i = 0; i < n; i++, p += 20)
+    {
+        cal.point[i].x      = (int32_t)get32(p);
+        cal.point[i].y      = (int32_t)get32(p +  4);
+        cal.point[i].xValue = (int32_t)get32(p +  8);
+        cal.point[i].yValue = (int32_t)get32(p + 12);
+        cal.point[i].zValue = (int32_t)get32(p + 16);
+    }
+    return true;
+}
+
+
+/**
+ * Starts the collection of the raw values for nbrPoints targets 
+ * (at most XPT2046_MAX_CAL_POINTS). A point is accepted as soon as
+ * its confidence is sufficient, but after nbrTouches touches at the
+ * latest.
+ */
+void CalibrationStateMachine::start(const TouchPoint targets[], int nbrPoints, int nbrTouches)
+{
+    if (nbrPoints > XPT2046_MAX_CAL_POINTS) nbrPoints = XPT2046_MAX_CAL_POINTS;
+    _cal.nbrPoints = nbrPoints;
+    for (int i = 0; i < nbrPoints; i++)
+    {
+        _cal.point[i] = targets[i];
+        _cal.point[i].xValue = _cal.point[i].yValue = _cal.point[i].zValue = 0;
+        _confidence[i] = 0;
+    }
+    _nbrTouches = nbrTouches > 0 ? nbrTouches : 1;
+    _point = 0;
+    _touches = 0;
+    _nWin = _iWin = 0;
+    _state = nbrPoints > 0 ? WAIT_PEN_DOWN : IDLE;
+}
+
+
+/**
+ * Advances the state machine by one sample. The raw 
+ * values are only evaluated when penDown is true.
+ */
+CalibrationStateMachine::Event CalibrationStateMachine::feed(bool penDown, int xValue, int yValue, uint32_t ms)
+{
+    switch (_state)
+    {
+        case WAIT_PEN_DOWN:
+            if (! penDown) break;
+            _state = ACQUIRE;
+            _settle = 0;
+            _touches++;
+            // fall through
+
+        case ACQUIRE:
+            if (! penDown)
+            {   // lifted before the confidence was reached
+                if (_touches >= _nbrTouches && _nWin > 0) 
+                {
+                    _msPenUp = ms ? ms : 1;
+                    return _accept();
+                }
+                _state = WAIT_PEN_DOWN;
+                break;
+            }
+            if (_settle < XPT2046_CAL_SETTLE_SAMPLES)
+            {   // the pen is still landing
+                _settle++;
+                break;
+            }
+            _xWin[_iWin] = xValue;
+            _yWin[_iWin] = yValue;
+            _iWin = (_iWin + 1) % XPT2046_CAL_WINDOW;
+            if (_nWin < XPT2046_CAL_WINDOW) _nWin++;
+            if (_nWin < XPT2046_CAL_MIN_SAMPLES) break;
+            {
+                int x, y;
+                if (_evaluate(x, y) < XPT2046_CAL_MIN_CONFIDENCE) break;
+            }
+            _msPenUp = 0;
+            return _accept();
+
+        case WAIT_PEN_UP:
+            if (penDown)
+            {   // no samples while the pen was up (PENIRQ, trace): the next touch ends the pen up time
+                if (_msPenUp == 0 || ms - _msPenUp < XPT2046_CAL_PEN_UP_MS)
+                {
+                    _msPenUp = 0;
+                    break;
+                }
+                Event ev = _nextPoint();
+                if (ev == EV_NEXT_POINT) feed(penDown, xValue, yValue, ms);
+                return ev;
+            }
+            if (_msPenUp == 0) _msPenUp = ms ? ms : 1;
+            if (ms - _msPenUp < XPT2046_CAL_PEN_UP_MS) break;
+            return _nextPoint();
+
+        default:
+        break;
+    }
+    return EV_NONE;
+}
+
+
+/**
+ * Takes the mean of the inliers as raw value of the current point
+ */
+CalibrationStateMachine::Event CalibrationStateMachine::_accept()
+{
+    int x, y;
+    _confidence[_point] = _evaluate(x, y);
+    _cal.point[_point].xValue = x;
+    _cal.point[_point].yValue = y;
+    _state = WAIT_PEN_UP;
+    return EV_TOUCH;
+}
+
+
+/**
+ * Goes on with the next point after the pen was lifted
+ */
+CalibrationStateMachine::Event CalibrationStateMachine::_nextPoint()
+{
+    _touches = 0;
+    _nWin = _iWin = 0;
+    if (++_point < _cal.nbrPoints)
+    {
+        _state = WAIT_PEN_DOWN;
+        return EV_NEXT_POINT;
+    }
+    _state = DONE;
+    return EV_FINISHED;
+}
+
+
+/**
+ * Sorts n values in ascending order
+ */
+static void sortValues(uint16_t *v, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        uint16_t t = v[i];
+        int j = i;
+        for (; j > 0 && v[j - 1] > t; j--) v[j] = v[j - 1];
+        v[j] = t;
+    }
+}
+
+
+/**
+ * Median and median absolute deviation of 1 to XPT2046_CAL_WINDOW values
+ */
+static void medianMad(const uint16_t *v, int n, int &median, int &mad)
+{
+    uint16_t tmp[XPT2046_CAL_WINDOW] = {};
+    for (int i = 0; i < n; i++) tmp[i] = v[i];
+    sortValues(tmp, n);
+    median = tmp[n / 2];
+    for (int i = 0; i < n; i++) tmp[i] = v[i] > median ? v[i] - median : median - v[i];
+    sortValues(tmp, n);
+    mad = tmp[n / 2];
+}
+
+
+/**
+ * Rejects the samples of the window further than 3 sigma from 
+ * the median (sigma estimated as 1.5 * MAD), returns the mean 
+ * of the remaining samples in x, y and the confidence in percent
+ */
+int CalibrationStateMachine::_evaluate(int &x, int &y)
+{
+    int xMed, xMad, yMed, yMad;
+    medianMad(_xWin, _nWin, xMed, xMad);
+    medianMad(_yWin, _nWin, yMed, yMad);
+
+    int sigma = (3 * (xMad > yMad ? xMad : yMad) + 1) / 2;
+    int limit = 3 * sigma > 4 ? 3 * sigma : 4;
+    int32_t xSum = 0, ySum = 0;
+    int n = 0;
+    for (int i = 0; i < _nWin; i++)
+    {
+        int dx = _xWin[i] - xMed;
+        int dy = _yWin[i] - yMed;
+        if (dx > limit || -dx > limit || dy > limit || -dy > limit) continue;
+        xSum += _xWin[i];
+        ySum += _yWin[i];
+        n++;
+    }
+    if (n == 0)
+    {   // cannot happen, the median itself is an inlier
+        x = xMed;
+        y = yMed;
+        return 0;
+    }
+    x = (xSum + n / 2) / n;
+    y = (ySum + n / 2) / n;
+    return (100 * n * XPT2046_CAL_STABLE_TOL) / (_nWin * (XPT2046_CAL_STABLE_TOL + sigma));
+}
@@ -0,0 +1,172 @@
+/**
+ * Header       XPT2046_Calibration.h
+ *
+ * Purpose      Calibration model of the touchpad. The raw values xValue, yValue
+ *              of the XPT2046 are mapped to screen coordinates by an affine
+ *              transform, which also corrects rotation and skew between the
+ *              touch layer and the display:
+ *                  x = a * xValue + b * yValue + c
+ *                  y = d * xValue + e * yValue + f
+ *              The six coefficients are fitted by least squares to the
+ *              calibration points (at least 3 points not on a line). With only
+ *              2 points the fit falls back to independent scale and offset of
+ *              each axis, like the former map() calls.
+ *              The coefficients are stored as fixed point numbers with
+ *              XPT2046_FIX_SHIFT fractional bits, so the transform of a sample
+ *              needs 4 integer multiply-adds and no division.
+ *
+ *              The calibration is made in landscape orientation (rotation 0).
+ *              rotateAffineTransform() folds the screen rotation into the matrix,
+ *              so that the transform delivers screen coordinates for any rotation
+ *              without further case distinction.
+ *
+ *              packCalibration() / unpackCalibration() serialize the calibration
+ *              into a single blob that is stored with Preferences::putBytes():
+ *                  header   uint16 magic, uint8 version, uint8 header size,
+ *                           uint16 payload size, uint16 reserved
+ *                  payload  int32 nbrPoints, nbrPoints * 5 int32 (x, y, xValue,
+ *                           yValue, zValue), little endian
+ *                  crc      CRC-32 of header and payload
+ *              Later versions may only append fields to the payload, readers
+ *              ignore what they do not know, so older firmware still reads the
+ *              points of a newer blob.
+ *
+ *              CalibrationStateMachine collects the raw values of the calibration
+ *              points incrementally. It is fed with one sample at a time and
+ *              never blocks:
+ *                WAIT_PEN_DOWN  target is shown, waiting for the pen
+ *                ACQUIRE        pen is down, the samples after the first
+ *                               XPT2046_CAL_SETTLE_SAMPLES go into a window of the
+ *                               last XPT2046_CAL_WINDOW samples. From
+ *                               XPT2046_CAL_MIN_SAMPLES on, median and MAD (median
+ *                               absolute deviation) of the window are computed,
+ *                               samples further than 3 sigma from the median are
+ *                               rejected as outliers and the confidence of the
+ *                               point is estimated from the share of inliers and
+ *                               their spread. As soon as the confidence reaches
+ *                               XPT2046_CAL_MIN_CONFIDENCE, the mean of the inliers
+ *                               is taken as raw value of the point.
+ *                               If the pen is lifted earlier, the next touch adds
+ *                               to the same window. After nbrTouches touches the
+ *                               best estimate is taken regardless of confidence.
+ *                WAIT_PEN_UP    waiting until the pen has been up for
+ *                               XPT2046_CAL_PEN_UP_MS, then the next target follows.
+ *                               Without samples while the pen is up, e.g. from
+ *                               a trace, a touch after that time starts the
+ *                               next target
+ *                DONE           all points collected, result() is valid
+ *              The memory used does not depend on the number of samples.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef XPT2046_MAX_CAL_POINTS
+  #define XPT2046_MAX_CAL_POINTS 5
+#endif
+
+#define XPT2046_CAL_MAGIC        0xCA1B
+#define XPT2046_CAL_VERSION      1
+#define XPT2046_CAL_HEADER_SIZE  8
+#define XPT2046_CAL_BLOB_MAX     (XPT2046_CAL_HEADER_SIZE + 4 + 20 * XPT2046_MAX_CAL_POINTS + 4)
+#define XPT2046_CAL_BLOB_READ_MAX (XPT2046_CAL_BLOB_MAX + 512)  // room for the fields of later versions
+
+#ifndef XPT2046_CAL_WINDOW
+  #define XPT2046_CAL_WINDOW          16  // samples kept per point
+#endif
+#ifndef XPT2046_CAL_MIN_SAMPLES
+  #define XPT2046_CAL_MIN_SAMPLES     6   // samples needed before a point can be accepted
+#endif
+#ifndef XPT2046_CAL_SETTLE_SAMPLES
+  #define XPT2046_CAL_SETTLE_SAMPLES  2   // samples ignored after the pen went down
+#endif
+#ifndef XPT2046_CAL_STABLE_TOL
+  #define XPT2046_CAL_STABLE_TOL      24  // spread (raw units) at which the confidence is halved
+#endif
+#ifndef XPT2046_CAL_MIN_CONFIDENCE
+  #define XPT2046_CAL_MIN_CONFIDENCE  70  // percent
+#endif
+#ifndef XPT2046_CAL_PEN_UP_MS
+  #define XPT2046_CAL_PEN_UP_MS      50  // pen up debounce time
+#endif
+
+#define XPT2046_FIX_SHIFT 16
+#define XPT2046_FIX_ONE   (1L << XPT2046_FIX_SHIFT)
+
+using TouchPoint = struct tpnt
+{
+    int x,       y,               // screen coordinates
+        xValue,  yValue, zValue,  // raw values read from touchpad, zValue = Z1 + 4095 - Z2
+        rTouch;                   // touch resistance in ohms, smaller means harder (see XPT2046_Pressure.h)
+};
+
+using TouchCalibration = struct tcal
+{
+    int        nbrPoints;                         // number of valid points
+    TouchPoint point[XPT2046_MAX_CAL_POINTS];     // target and raw values
+};
+
+using AffineTransform = struct atrf
+{
+    int32_t a, b, c,   // x = (a * xValue + b * yValue + c) >> XPT2046_FIX_SHIFT
+            d, e, f;   // y = (d * xValue + e * yValue + f) >> XPT2046_FIX_SHIFT
+};
+
+
+bool fitAffineTransform(const TouchCalibration &cal, AffineTransform &t, float *rmsResidual = nullptr);
+AffineTransform rotateAffineTransform(const AffineTransform &t, uint8_t rotation, int width, int height);
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+size_t packCalibration(const TouchCalibration &cal, uint8_t *buf, size_t bufSize);
+bool unpackCalibration(const uint8_t *buf, size_t len, TouchCalibration &cal);
+
+
+/**
+ * Maps the raw values to screen coordinates
+ */
+inline void applyAffineTransform(const AffineTransform &t, int xValue, int yValue, int &x, int &y)
+{
+    const int32_t round = 1L << (XPT2046_FIX_SHIFT - 1);
+    x = (int)((t.a * xValue + t.b * yValue + t.c + round) >> XPT2046_FIX_SHIFT);
+    y = (int)((t.d * xValue + t.e * yValue + t.f + round) >> XPT2046_FIX_SHIFT);
+}
+
+
+class CalibrationStateMachine
+{
+    public:
+        enum State : uint8_t { IDLE, WAIT_PEN_DOWN, ACQUIRE, WAIT_PEN_UP, DONE };
+        enum Event : uint8_t { EV_NONE,          // nothing to show
+                               EV_TOUCH,         // the current point was accepted, lift the pen
+                               EV_NEXT_POINT,    // the previous point is complete, show the current one
+                               EV_FINISHED };    // all points are complete
+
+        void  start(const TouchPoint targets[], int nbrPoints, int nbrTouches);
+        Event feed(bool penDown, int xValue, int yValue, uint32_t ms);
+        void  cancel() { _state = IDLE; }
+
+        State state() const { return _state; }
+        bool  isRunning() const { return _state != IDLE && _state != DONE; }
+        int   currentPoint() const { return _point; }
+        int   confidence(int point) const { return _confidence[point]; }
+        const TouchCalibration &result() const { return _cal; }
+
+    private:
+        State    _state = IDLE;
+        TouchCalibration _cal;
+        uint8_t  _confidence[XPT2046_MAX_CAL_POINTS];   // percent
+        int      _nbrTouches = 1;
+        int      _point = 0;
+        int      _touches = 0;
+        int      _settle = 0;
+        uint16_t _xWin[XPT2046_CAL_WINDOW];
+        uint16_t _yWin[XPT2046_CAL_WINDOW];
+        int      _nWin = 0;
+        int      _iWin = 0;
+        uint32_t _msPenUp = 0;
+        int      _evaluate(int &x, int &y);
+        Event    _accept();
+        Event    _nextPoint();
+};
@@ -0,0 +1,73 @@
+/**
+ * Header       XPT2046_Dispatch.h
+ *
+ * Purpose      Subscriber table for touch events. Each event type has a fixed
+ *              size array of up to XPT2046_MAX_SUBSCRIBERS handlers, each with
+ *              a context pointer, e.g. the widget instance a member function
+ *              is forwarded to:
+ *                  static void onTap(void *ctx, const TouchEvent &ev)
+ *                  { static_cast<Button *>(ctx)->tapped(ev); }
+ *                  touchpad.subscribe(TOUCH_SHORT, onTap, &okButton);
+ *              The table is part of the object, nothing is allocated on the heap.
+ *              Dispatching an event is a loop over a contiguous array.
+ *              Handlers are called in the order of subscription. Removing a
+ *              handler moves the ones behind it down by one slot, so 
+ *              (un)subscribe must not be called from a handler of the same 
+ *              event type.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "XPT2046_Gesture.h"
+
+#ifndef XPT2046_MAX_SUBSCRIBERS
+  #define XPT2046_MAX_SUBSCRIBERS 8   // handlers per event type
+#endif
+
+using TouchHandler = void (*)(void *ctx, const TouchEvent &ev);
+
+class TouchDispatcher
+{
+    public:
+        bool subscribe(TouchEventType type, TouchHandler fn, void *ctx)
+        {
+            if (type >= TOUCH_EVENT_TYPES || ! fn || _count[type] >= XPT2046_MAX_SUBSCRIBERS) return false;
+            _sub[type][_count[type]++] = Subscriber {fn, ctx};
+            return true;
+        }
+
+        bool unsubscribe(TouchEventType type, TouchHandler fn, void *ctx)
+        {
+            if (type >= TOUCH_EVENT_TYPES) return false;
+            Subscriber *s = _sub[type];
+            for (int i = 0; i < _count[type]; i++)
+            {
+                if (s[i].fn == fn && s[i].ctx == ctx)
+                {
+                    for (int n = --_count[type]; i < n; i++) s[i] = s[i + 1];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void dispatch(const TouchEvent &ev) const
+        {
+            const Subscriber *s = _sub[ev.type];
+            for (int i = 0, n = _count[ev.type]; i < n; i++) s[i].fn(s[i].ctx, ev);
+        }
+
+        int subscribers(TouchEventType type) const
+        { return type < TOUCH_EVENT_TYPES ? _count[type] : 0; }
+
+    private:
+        using Subscriber = struct tsub
+        {
+            TouchHandler fn;
+            void        *ctx;
+        };
+        Subscriber _sub[TOUCH_EVENT_TYPES][XPT2046_MAX_SUBSCRIBERS];
+        uint8_t    _count[TOUCH_EVENT_TYPES] = {};
+};
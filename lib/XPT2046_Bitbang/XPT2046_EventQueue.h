@@ -0,0 +1,68 @@
+/**
+ * Header       XPT2046_EventQueue.h
+ *
+ * Purpose      Lock-free single-producer / single-consumer ring buffer.
+ *              The sampling task of XPT2046_Bitbang is the only producer,
+ *              the application (or XPT2046_Bitbang::loop()) the only consumer.
+ *              The producer owns _head, the consumer owns _tail. An element is
+ *              written completely before _head is published with release
+ *              semantics and read completely before _tail is published, so
+ *              neither side can see a torn element.
+ *              When the queue is full the new element is dropped and counted.
+ *              Capacity N must be a power of 2, one slot is never used.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <typename T, size_t N>
+class EventQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "EventQueue capacity must be a power of 2");
+
+    public:
+        bool push(const T &item)
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            uint32_t next = (head + 1) & (N - 1);
+            if (next == _tail.load(std::memory_order_acquire))
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _buf[head] = item;
+            _head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T &item)
+        {
+            uint32_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) return false;
+            item = _buf[tail];
+            _tail.store((tail + 1) & (N - 1), std::memory_order_release);
+            return true;
+        }
+
+        bool isEmpty() const
+        { return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire); }
+
+        size_t size() const
+        { return (_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire)) & (N - 1); }
+
+        size_t capacity() const
+        { return N - 1; }
+
+        uint32_t dropped() const
+        { return _dropped.load(std::memory_order_relaxed); }
+
+    private:
+        T _buf[N];
+        std::atomic<uint32_t> _head{0};
+        std::atomic<uint32_t> _tail{0};
+        std::atomic<uint32_t> _dropped{0};
+};
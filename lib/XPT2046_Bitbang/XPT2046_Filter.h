@@ -0,0 +1,101 @@
+/**
+ * Header       XPT2046_Filter.h
+ *
+ * Purpose      Oversampling filter for the raw conversions of the XPT2046.
+ *              Each axis is converted XPT2046_OVERSAMPLING times into a fixed
+ *              size buffer on the stack, which is then reduced to a single value
+ *              by the filter selected with XPT2046_FILTER:
+ *                - XPT2046_FILTER_MEDIAN        median of the N values
+ *                - XPT2046_FILTER_TRIMMED_MEAN  mean of the values without the
+ *                                               N/4 smallest and N/4 largest
+ *              With XPT2046_DISCARD_FIRST = 1 one additional conversion is made
+ *              and thrown away after switching the axis, while the reference
+ *              and the panel voltages settle.
+ *              Both values are fixed at compile time (build_flags -D ...), so
+ *              the loops have a constant trip count and the sorting network
+ *              uses compare-exchange without data dependent branches.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define XPT2046_FILTER_MEDIAN        0
+#define XPT2046_FILTER_TRIMMED_MEAN  1
+
+#ifndef XPT2046_OVERSAMPLING
+  #define XPT2046_OVERSAMPLING 5
+#endif
+
+#ifndef XPT2046_FILTER
+  #define XPT2046_FILTER XPT2046_FILTER_MEDIAN
+#endif
+
+#ifndef XPT2046_DISCARD_FIRST
+  #define XPT2046_DISCARD_FIRST 1
+#endif
+
+static_assert(XPT2046_OVERSAMPLING >= 1 && XPT2046_OVERSAMPLING <= 16, "XPT2046_OVERSAMPLING must be 1..16");
+
+
+/**
+ * Sorts the values in ascending order with an
+ * odd-even transposition network
+ */
+template <size_t N>
+inline void sortSamples(uint16_t (&v)[N])
+{
+    for (size_t pass = 0; pass < N; pass++)
+    {
+        for (size_t i = pass & 1; i + 1 < N; i += 2)
+        {
+            uint16_t a = v[i];
+            uint16_t b = v[i + 1];
+            v[i]     = a < b ? a : b;
+            v[i + 1] = a < b ? b : a;
+        }
+    }
+}
+
+
+/**
+ * Median of N values, the buffer gets sorted
+ */
+template <size_t N>
+inline uint16_t medianOf(uint16_t (&v)[N])
+{
+    sortSamples(v);
+    return (N & 1) ? v[N / 2] : (uint16_t)((v[N / 2 - 1] + v[N / 2] + 1) >> 1);
+}
+
+
+/**
+ * Mean of N values without the N/4 smallest and
+ * the N/4 largest ones, the buffer gets sorted
+ */
+template <size_t N>
+inline uint16_t trimmedMeanOf(uint16_t (&v)[N])
+{
+    const size_t trim = N / 4;
+    const size_t n = N - 2 * trim;
+    uint32_t sum = 0;
+    sortSamples(v);
+    for (size_t i = trim; i < N - trim; i++) sum += v[i];
+    return (uint16_t)((sum + n / 2) / n);
+}
+
+
+/**
+ * Reduces the N values with the filter selected by XPT2046_FILTER
+ */
+template <size_t N>
+inline uint16_t filterSamples(uint16_t (&v)[N])
+{
+#if XPT2046_FILTER == XPT2046_FILTER_TRIMMED_MEAN
+    return trimmedMeanOf(v);
+#else
+    return medianOf(v);
+#endif
+}
@@ -0,0 +1,114 @@
+/**
+ * File         XPT2046_Gesture.cpp
+ *
+ * Purpose      Incremental gesture recognizer (see XPT2046_Gesture.h)
+ */
+
+#include "XPT2046_Gesture.h"
+
+static inline int iabs(int v) { return v < 0 ? -v : v; }
+
+
+/**
+ *                                 up
+ *  Determines the swipe          \   /
+ *  direction relative to     left  o  right
+ *  the starting point            /   \
+ *                                 down
+ *  Returns TOUCH_NONE if the displacement is
+ *  too short or exactly on a diagonal.
+ */
+TouchEventType swipeDirection(int dx, int dy)
+{
+    int ax = iabs(dx);
+    int ay = iabs(dy);
+    if (ax < XPT2046_SWIPE_MIN_DIST && ay < XPT2046_SWIPE_MIN_DIST) return TOUCH_NONE;
+    if (ax > ay) return dx > 0 ? TOUCH_SWIPE_RIGHT : TOUCH_SWIPE_LEFT;
+    if (ay > ax) return dy > 0 ? TOUCH_SWIPE_DOWN  : TOUCH_SWIPE_UP;
+    return TOUCH_NONE;
+}
+
+
+/**
+ * Fills in an event at the last position. With report = true
+ * the position becomes the reference of the next dx, dy.
+ */
+void GestureRecognizer::_event(TouchEvent &ev, TouchEventType type, bool report)
+{
+    ev.type = type;
+    ev.x  = _x;
+    ev.y  = _y;
+    ev.dx = _x - _xr;
+    ev.dy = _y - _yr;
+    ev.vx = _vx;
+    ev.vy = _vy;
+    ev.ms = _msLast;
+    ev.duration = _msLast - _msStart;
+    if (report)
+    {
+        _xr = _x;
+        _yr = _y;
+    }
+}
+
+
+/**
+ * Consumes one sample and returns the number
+ * of events stored into events[]
+ */
+int GestureRecognizer::feed(bool penDown, int x, int y, uint32_t ms, TouchEvent events[XPT2046_MAX_EVENTS])
+{
+    int n = 0;
+
+    if (! penDown)
+    {
+        if (! _active) return 0;
+        _active = false;
+        if (! _decided && _msLast - _msStart > XPT2046_SHORT_TOUCH_MS) _event(events[n++], TOUCH_SHORT, false);
+        _event(events[n++], TOUCH_PEN_UP, true);
+        return n;
+    }
+
+    if (! _active)
+    {
+        _active  = true;
+        _decided = false;
+        _x0 = _x = _xr = x;
+        _y0 = _y = _yr = y;
+        _vx = _vy = 0;
+        _msStart = _msLast = _msMove = ms;
+        _event(events[n++], TOUCH_PEN_DOWN, true);
+        return n;
+    }
+
+    // velocity of the last step in pixels/s, smoothed over about 4 samples
+    uint32_t dt = ms - _msLast;
+    if (dt > 0)
+    {
+        _vx += ((x - _x) * 1000 / (int)dt - _vx) / 4;
+        _vy += ((y - _y) * 1000 / (int)dt - _vy) / 4;
+    }
+    _x = x;
+    _y = y;
+    _msLast = ms;
+
+    if (ms - _msMove >= XPT2046_MOVE_MIN_MS &&
+        (iabs(x - _xr) >= XPT2046_MOVE_MIN_DIST || iabs(y - _yr) >= XPT2046_MOVE_MIN_DIST))
+    {
+        _msMove = ms;
+        _event(events[n++], TOUCH_MOVE, true);
+    }
+    if (_decided) return n;
+
+    int dx = x - _x0;
+    int dy = y - _y0;
+    TouchEventType g = swipeDirection(dx, dy);
+    if (g == TOUCH_NONE && iabs(dx) < XPT2046_SWIPE_MIN_DIST && iabs(dy) < XPT2046_SWIPE_MIN_DIST
+        && ms - _msStart > XPT2046_LONG_TOUCH_MS) g = TOUCH_LONG;
+    if (g != TOUCH_NONE)
+    {
+        _decided = true;
+        _event(events[n++], g, false);
+    }
+    return n;
+}
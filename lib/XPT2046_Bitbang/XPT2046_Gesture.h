@@ -0,0 +1,103 @@
+/**
+ * Header       XPT2046_Gesture.h
+ *
+ * Purpose      Incremental gesture recognizer. Each sample is consumed as it
+ *              arrives, only the start point, the last point and the smoothed
+ *              velocity of the current touch are kept, so the memory does not
+ *              depend on the length of the trajectory. All arithmetic is integer.
+ *
+ *              A sample produces up to XPT2046_MAX_EVENTS touch events:
+ *                - pen down    first sample of a touch
+ *                - move        the pen has moved XPT2046_MOVE_MIN_DIST pixels since
+ *                              the last reported position. Moves are reported at
+ *                              most every XPT2046_MOVE_MIN_MS, the samples in between
+ *                              are coalesced into the next move
+ *                - pen up      the pen was lifted, the position is the last one
+ *              and the gesture, which is decided as soon as possible:
+ *                - swipe       the pen has moved XPT2046_SWIPE_MIN_DIST pixels
+ *                              from the start point, the direction is the axis
+ *                              with the larger displacement (fires mid-gesture)
+ *                - long touch  the pen has been held within XPT2046_SWIPE_MIN_DIST
+ *                              for XPT2046_LONG_TOUCH_MS (fires mid-gesture)
+ *                - short touch the pen went up after more than
+ *                              XPT2046_SHORT_TOUCH_MS without swipe or long touch
+ *              Each touch produces at most one gesture.
+ *              dx, dy of an event are relative to the position of the previous
+ *              pen down, move or pen up event, so a scroll list just adds them up.
+ *              vx, vy are the smoothed velocity in pixels/s, e.g. to continue
+ *              a kinetic scroll after pen up.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#ifndef XPT2046_SWIPE_MIN_DIST
+  #define XPT2046_SWIPE_MIN_DIST  20   // pixels
+#endif
+#ifndef XPT2046_LONG_TOUCH_MS
+  #define XPT2046_LONG_TOUCH_MS   280
+#endif
+#ifndef XPT2046_SHORT_TOUCH_MS
+  #define XPT2046_SHORT_TOUCH_MS  35
+#endif
+#ifndef XPT2046_MOVE_MIN_MS
+  #define XPT2046_MOVE_MIN_MS     20   // rate limit of move events
+#endif
+#ifndef XPT2046_MOVE_MIN_DIST
+  #define XPT2046_MOVE_MIN_DIST   2    // pixels
+#endif
+
+#define XPT2046_MAX_EVENTS 2           // events per sample
+
+enum TouchEventType : uint8_t { TOUCH_NONE,
+                                TOUCH_SHORT,
+                                TOUCH_LONG,
+                                TOUCH_SWIPE_RIGHT,
+                                TOUCH_SWIPE_UP,
+                                TOUCH_SWIPE_LEFT,
+                                TOUCH_SWIPE_DOWN,
+                                TOUCH_PEN_DOWN,
+                                TOUCH_MOVE,
+                                TOUCH_PEN_UP,
+                                TOUCH_EVENT_TYPES };
+
+using TouchEvent = struct tevt
+{
+    TouchEventType type;
+    int      x,  y;          // screen coordinates
+    int      dx, dy;         // displacement since the previous position event
+    int      vx, vy;         // velocity in pixels/s
+    uint32_t ms;             // time of the sample
+    uint32_t duration;       // ms since pen down
+};
+
+TouchEventType swipeDirection(int dx, int dy);
+
+
+class GestureRecognizer
+{
+    public:
+        int  feed(bool penDown, int x, int y, uint32_t ms, TouchEvent events[XPT2046_MAX_EVENTS]);
+        void reset() { _active = false; _decided = false; }
+
+        bool     isActive() const { return _active; }
+        int      x() const { return _x; }                // last position
+        int      y() const { return _y; }
+        int      vx() const { return _vx; }
+        int      vy() const { return _vy; }
+        uint32_t duration() const { return _msLast - _msStart; }
+
+    private:
+        bool     _active  = false;  // pen is down
+        bool     _decided = false;  // the gesture of this touch has been reported
+        int      _x0 = 0, _y0 = 0;  // start point
+        int      _x  = 0, _y  = 0;  // last point
+        int      _xr = 0, _yr = 0;  // last reported point
+        int      _vx = 0, _vy = 0;
+        uint32_t _msStart = 0;
+        uint32_t _msLast  = 0;
+        uint32_t _msMove  = 0;      // time of the last move event
+        void     _event(TouchEvent &ev, TouchEventType type, bool report);
+};
@@ -0,0 +1,111 @@
+/**
+ * Header       XPT2046_Gpio.h
+ *
+ * Purpose      Minimal hardware abstraction for the pins of the bit-bang engine.
+ *              On the ESP32 a pin is driven by writing its bit mask directly to
+ *              the GPIO set/clear registers (GPIO_OUT_W1TS / GPIO_OUT_W1TC and
+ *              their *1* counterparts for pins 32..39) and read from GPIO_IN /
+ *              GPIO_IN1. The register addresses and the mask are resolved once
+ *              in attach(), so high(), low() and read() are single loads and
+ *              stores without branches.
+ *              On other targets (e.g. a Linux host with a simulated pin backend)
+ *              the Arduino functions digitalWrite() / digitalRead() are used.
+ *
+ *              The clock of the engine is timed with the CPU cycle counter,
+ *              which allows clock rates up to the 2 MHz limit of the XPT2046
+ *              instead of the 5 us granularity of delayMicroseconds().
+ *              The host build of the tests (test/native) defines XPT2046_HOST
+ *              and provides a cycle counter of 240 MHz like the ESP32.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <soc/soc.h>
+  #include <soc/gpio_reg.h>
+#endif
+
+#define XPT2046_MAX_CLOCK_HZ      2000000UL // DCLK limit of the XPT2046
+#define XPT2046_DEFAULT_CLOCK_HZ  1000000UL // leaves enough acquisition time for the panel
+
+
+class GpioPin
+{
+    public:
+        void attach(uint8_t pin)
+        {
+            _pin = pin;
+        #if defined(ARDUINO_ARCH_ESP32)
+            if (pin < 32)
+            {
+                _mask   = 1UL << pin;
+                _setReg = (volatile uint32_t *)GPIO_OUT_W1TS_REG;
+                _clrReg = (volatile uint32_t *)GPIO_OUT_W1TC_REG;
+                _inReg  = (volatile uint32_t *)GPIO_IN_REG;
+                _shift  = pin;
+            }
+            else
+            {
+                _mask   = 1UL << (pin - 32);
+                _setReg = (volatile uint32_t *)GPIO_OUT1_W1TS_REG;
+                _clrReg = (volatile uint32_t *)GPIO_OUT1_W1TC_REG;
+                _inReg  = (volatile uint32_t *)GPIO_IN1_REG;
+                _shift  = pin - 32;
+            }
+        #endif
+        }
+
+    #if defined(ARDUINO_ARCH_ESP32)
+        inline void high() const { *_setReg = _mask; }
+        inline void low()  const { *_clrReg = _mask; }
+        inline uint32_t read() const { return (*_inReg >> _shift) & 1UL; }
+    #else
+        inline void high() const { digitalWrite(_pin, HIGH); }
+        inline void low()  const { digitalWrite(_pin, LOW); }
+        inline uint32_t read() const { return digitalRead(_pin) ? 1UL : 0UL; }
+    #endif
+        inline void write(bool level) const { if (level) high(); else low(); }
+        uint8_t pin() const { return _pin; }
+
+    private:
+        uint8_t _pin = 0;
+    #if defined(ARDUINO_ARCH_ESP32)
+        uint32_t _mask = 0;
+        uint32_t _shift = 0;
+        volatile uint32_t *_setReg = nullptr;
+        volatile uint32_t *_clrReg = nullptr;
+        volatile uint32_t *_inReg  = nullptr;
+    #endif
+};
+
+
+/**
+ * Returns the current value of the free running
+ * CPU cycle counter (or of micros() on other targets)
+ */
+inline uint32_t gpioCycles()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    return ESP.getCycleCount();
+#elif defined(XPT2046_HOST)
+    return hostCycleCount();
+#else
+    return micros();
+#endif
+}
+
+
+/**
+ * Number of gpioCycles() ticks per second
+ */
+inline uint32_t gpioCyclesPerSecond()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    return ESP.getCpuFreqMHz() * 1000000UL;
+#elif defined(XPT2046_HOST)
+    return hostCyclesPerSecond();
+#else
+    return 1000000UL;
+#endif
+}
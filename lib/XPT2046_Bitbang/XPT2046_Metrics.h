@@ -0,0 +1,53 @@
+/**
+ * Header       XPT2046_Metrics.h
+ *
+ * Purpose      Counters of the touch driver, enabled with build_flags
+ *              -D XPT2046_METRICS=1. They count the samples taken, the
+ *              samples rejected by Z1 or by the touch resistance, the events
+ *              per type and the handlers called, and collect a histogram of
+ *              the CPU cycles per sample in powers of 2 starting at
+ *              2^XPT2046_METRICS_MIN_LOG2 cycles.
+ *              The statements wrapped in XPT2046_METRIC() are removed by the
+ *              preprocessor when the metrics are disabled (default), so the
+ *              hot path does not pay for them. getMetrics() of the driver
+ *              returns the counters, printMetrics() prints them.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "XPT2046_Gesture.h"
+
+#ifndef XPT2046_METRICS
+  #define XPT2046_METRICS 0
+#endif
+
+#if XPT2046_METRICS
+  #define XPT2046_METRIC(statement) do { statement; } while (0)
+#else
+  #define XPT2046_METRIC(statement) do { } while (0)
+#endif
+
+#define XPT2046_METRICS_BUCKETS   12
+#define XPT2046_METRICS_MIN_LOG2  10   // first bucket < 2^11 cycles
+
+using TouchMetrics = struct tmet
+{
+    uint32_t loops;                        // calls of loop() or iterations of the sampling task
+    uint32_t samples;                      // samples that talked to the XPT2046
+    uint32_t rejectedZ1;                   // ended after Z1, no contact
+    uint32_t rejectedPressure;             // touch resistance above the threshold
+    uint32_t events[TOUCH_EVENT_TYPES];    // events dispatched per type
+    uint32_t handlers;                     // handlers called
+    uint64_t busCycles;                    // cycles spent talking to the XPT2046
+    uint32_t cycles[XPT2046_METRICS_BUCKETS];
+
+    void addSample(uint32_t sampleCycles)
+    {
+        samples++;
+        busCycles += sampleCycles;
+        int b = sampleCycles ? 31 - __builtin_clz(sampleCycles) - XPT2046_METRICS_MIN_LOG2 : 0;
+        cycles[b < 0 ? 0 : (b >= XPT2046_METRICS_BUCKETS ? XPT2046_METRICS_BUCKETS - 1 : b)]++;
+    }
+};
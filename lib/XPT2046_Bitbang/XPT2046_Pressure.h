@@ -0,0 +1,114 @@
+/**
+ * Header       XPT2046_Pressure.h
+ *
+ * Purpose      Pen detection from the pressure measurements Z1 and Z2 of the XPT2046.
+ *              The touch resistance is calculated with formula 1 of the datasheet
+ *                  Rtouch = Rx-plate * X / 4096 * (Z2 / Z1 - 1)
+ *              where Rx-plate is the resistance of the X plate of the panel and
+ *              X the raw x position. The harder the pen is pressed, the smaller
+ *              Rtouch gets. The pen is down when Rtouch falls below rPenDown and
+ *              up again when it rises above rPenUp (hysteresis). While the pen
+ *              is down, the release threshold follows 1.5 times the running
+ *              average of Rtouch if that is larger, so a light touch is not
+ *              broken up by the noise of its own pressure.
+ *              Without touch Z1 stays near 0. Its noise floor is tracked on idle
+ *              samples, a Z1 below floor + XPT2046_Z1_MARGIN ends the sample
+ *              early, before Z2, X and Y are converted.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#ifndef XPT2046_RX_PLATE
+  #define XPT2046_RX_PLATE   300   // ohms, resistance of the X plate
+#endif
+#ifndef XPT2046_R_PEN_DOWN
+  #define XPT2046_R_PEN_DOWN 1000  // ohms
+#endif
+#ifndef XPT2046_R_PEN_UP
+  #define XPT2046_R_PEN_UP   1300  // ohms
+#endif
+#ifndef XPT2046_Z1_MARGIN
+  #define XPT2046_Z1_MARGIN  40    // raw units above the noise floor of Z1
+#endif
+
+class PressureDetector
+{
+    public:
+        void setPlateResistance(uint16_t rxPlate) { _rxPlate = rxPlate; }
+
+        void setThresholds(uint16_t rPenDown, uint16_t rPenUp)
+        {
+            _rPenDown = rPenDown;
+            _rPenUp   = rPenUp > rPenDown ? rPenUp : rPenDown;
+        }
+
+        /**
+         * Returns false if Z1 is too small for a touch. The noise
+         * floor of Z1 is tracked on these samples and the pen is up.
+         */
+        bool isZ1Active(int z1)
+        {
+            if (z1 >= (_z1Floor >> 4) + XPT2046_Z1_MARGIN) return true;
+            _z1Floor += ((z1 << 4) - _z1Floor) >> 3;  // floor += (z1 - floor) / 8
+            _penDown = false;
+            return false;
+        }
+
+        /**
+         * Touch resistance in ohms, 0xFFFF if not measurable
+         */
+        int resistance(int x, int z1, int z2) const
+        {
+            if (z1 <= 0) return 0xFFFF;
+            if (z2 <= z1) return 0;
+            uint32_t r = ((uint32_t)_rxPlate * (uint32_t)x >> 12) * (uint32_t)(z2 - z1) / (uint32_t)z1;
+            return r > 0xFFFF ? 0xFFFF : (int)r;
+        }
+
+        /**
+         * Applies the hysteresis to the touch resistance
+         * and returns true if the pen is down
+         */
+        bool update(int r)
+        {
+            if (! _penDown)
+            {
+                if (r >= _rPenDown) return false;
+                _penDown = true;
+                _rAvg = r;
+                return true;
+            }
+            int limit = _rAvg + (_rAvg >> 1);
+            if (limit < _rPenUp) limit = _rPenUp;
+            if (r > limit)
+            {
+                _penDown = false;
+                return false;
+            }
+            _rAvg += (r - _rAvg) >> 3;
+            return true;
+        }
+
+        /**
+         * The pen was lifted without a pressure measurement,
+         * e.g. PENIRQ is high. The next touch starts afresh.
+         */
+        void release()
+        {
+            _penDown = false;
+            _rAvg = 0;
+        }
+
+        bool isPenDown() const { return _penDown; }
+
+    private:
+        uint16_t _rxPlate  = XPT2046_RX_PLATE;
+        uint16_t _rPenDown = XPT2046_R_PEN_DOWN;
+        uint16_t _rPenUp   = XPT2046_R_PEN_UP;
+        int32_t  _z1Floor  = 0;    // noise floor of Z1 with 4 fractional bits
+        int      _rAvg     = 0;
+        bool     _penDown  = false;
+};
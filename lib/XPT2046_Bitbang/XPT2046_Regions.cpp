@@ -0,0 +1,149 @@
+/**
+ * File         XPT2046_Regions.cpp
+ *
+ * Purpose      Grid indexed registry of touch regions (see XPT2046_Regions.h)
+ */
+
+#include "XPT2046_Regions.h"
+
+static inline int cellOf(int v)
+{
+    v /= XPT2046_REGION_CELL;
+    return v < 0 ? 0 : (v >= XPT2046_REGION_CELLS ? XPT2046_REGION_CELLS - 1 : v);
+}
+
+
+/**
+ * Returns true if region a lies above region b
+ */
+bool TouchRegions::_above(int a, int b) const
+{
+    const Region &ra = _region[a], &rb = _region[b];
+    return ra.z > rb.z || (ra.z == rb.z && ra.seq > rb.seq);
+}
+
+
+/**
+ * Inserts the region into the lists of all cells it overlaps, in z order.
+ * Returns false if the pool of entries is exhausted.
+ */
+bool TouchRegions::_link(int id)
+{
+    const Region &r = _region[id];
+    for (int cy = cellOf(r.y); cy <= cellOf(r.y + r.h - 1); cy++)
+    {
+        for (int cx = cellOf(r.x); cx <= cellOf(r.x + r.w - 1); cx++)
+        {
+            if (_free == NONE) return false;
+            uint16_t *p = &_cell[cy][cx];
+            while (*p != NONE && _above(_entry[*p].id, id)) p = &_entry[*p].next;
+            uint16_t e = _free;
+            _free = _entry[e].next;
+            _entry[e] = Entry {(uint16_t)id, *p};
+            *p = e;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Removes the region from the lists of all cells it overlaps
+ */
+void TouchRegions::_unlink(int id)
+{
+    const Region &r = _region[id];
+    for (int cy = cellOf(r.y); cy <= cellOf(r.y + r.h - 1); cy++)
+    {
+        for (int cx = cellOf(r.x); cx <= cellOf(r.x + r.w - 1); cx++)
+        {
+            uint16_t *p = &_cell[cy][cx];
+            while (*p != NONE && _entry[*p].id != id) p = &_entry[*p].next;
+            if (*p == NONE) continue;
+            uint16_t e = *p;
+            *p = _entry[e].next;
+            _entry[e].next = _free;
+            _free = e;
+        }
+    }
+}
+
+
+/**
+ * Adds the rectangle x, y, w, h with the handler fn and returns the id of
+ * the region, -1 if the rectangle is empty or all regions or cell entries 
+ * are in use.
+ */
+int TouchRegions::add(int x, int y, int w, int h, TouchHandler fn, void *ctx, uint8_t z)
+{
+    if (w <= 0 || h <= 0) return -1;
+    for (int id = 0; id < XPT2046_MAX_REGIONS; id++)
+    {
+        if (_region[id].w) continue;
+        _region[id] = Region {(int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h, z, _seq++, fn, ctx};
+        if (_link(id)) return id;
+        remove(id);
+        return -1;
+    }
+    return -1;
+}
+
+
+bool TouchRegions::remove(int id)
+{
+    if (id < 0 || id >= XPT2046_MAX_REGIONS || ! _region[id].w) return false;
+    _unlink(id);
+    _region[id].w = 0;
+    return true;
+}
+
+
+void TouchRegions::clear()
+{
+    for (int id = 0; id < XPT2046_MAX_REGIONS; id++) _region[id].w = 0;
+    for (int cy = 0; cy < XPT2046_REGION_CELLS; cy++)
+    {
+        for (int cx = 0; cx < XPT2046_REGION_CELLS; cx++) _cell[cy][cx] = NONE;
+    }
+    for (int e = 0; e < XPT2046_REGION_ENTRIES; e++) _entry[e].next = e + 1 < XPT2046_REGION_ENTRIES ? e + 1 : NONE;
+    _free = 0;
+    _seq  = 0;
+}
+
+
+/**
+ * Returns the id of the topmost region containing x, y or -1
+ */
+int TouchRegions::hitTest(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= XPT2046_REGION_EXTENT || y >= XPT2046_REGION_EXTENT) return -1;
+    for (uint16_t e = _cell[y / XPT2046_REGION_CELL][x / XPT2046_REGION_CELL]; e != NONE; e = _entry[e].next)
+    {
+        const Region &r = _region[_entry[e].id];
+        if (x >= r.x && y >= r.y && x < r.x + r.w && y < r.y + r.h) return _entry[e].id;
+    }
+    return -1;
+}
+
+
+/**
+ * Calls the handler of the region hit by the event.
+ * Returns false if no region was hit.
+ */
+bool TouchRegions::dispatch(const TouchEvent &ev) const
+{
+    int id = hitTest(ev.x, ev.y);
+    if (id < 0) return false;
+    if (_region[id].fn) _region[id].fn(_region[id].ctx, ev);
+    return true;
+}
+
+
+/**
+ * Handler to subscribe the regions to a touch event,
+ * ctx is a pointer to the TouchRegions instance
+ */
+void TouchRegions::onEvent(void *ctx, const TouchEvent &ev)
+{
+    static_cast<TouchRegions *>(ctx)->dispatch(ev);
+}
@@ -0,0 +1,83 @@
+/**
+ * Header       XPT2046_Regions.h
+ *
+ * Purpose      Registry of rectangular touch regions (buttons, menu items) with
+ *              a handler each. The screen is divided into a uniform grid of
+ *              XPT2046_REGION_CELL pixels, each cell holds a list of the regions
+ *              overlapping it, sorted from top to bottom. A hit test only walks
+ *              the list of the one cell containing the point and stops at the
+ *              first region containing it, so its cost depends on how many
+ *              regions overlap there, not on the number of regions on the screen.
+ *              Overlapping regions are resolved by z, the region with the
+ *              highest z wins, for equal z the one added last.
+ *              The grid covers XPT2046_REGION_EXTENT pixels in both directions,
+ *              enough for all rotations of the 320 x 240 display.
+ *              The lists are linked through a pool of XPT2046_REGION_ENTRIES
+ *              entries, one per region and cell it overlaps. The default pool
+ *              holds every cell once plus 4 cells per region, add() fails if
+ *              it is exhausted. Nothing is allocated on the heap.
+
+ *              The regions can be fed directly from the event dispatcher:
+ *                  touchpad.subscribe(TOUCH_SHORT, TouchRegions::onEvent, &menu);
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "XPT2046_Dispatch.h"
+
+#ifndef XPT2046_MAX_REGIONS
+  #define XPT2046_MAX_REGIONS   32
+#endif
+#ifndef XPT2046_REGION_CELL
+  #define XPT2046_REGION_CELL   32    // pixels
+#endif
+#ifndef XPT2046_REGION_EXTENT
+  #define XPT2046_REGION_EXTENT 320   // pixels
+#endif
+
+#define XPT2046_REGION_CELLS ((XPT2046_REGION_EXTENT + XPT2046_REGION_CELL - 1) / XPT2046_REGION_CELL)
+
+#ifndef XPT2046_REGION_ENTRIES
+  #define XPT2046_REGION_ENTRIES (4 * XPT2046_MAX_REGIONS + XPT2046_REGION_CELLS * XPT2046_REGION_CELLS)
+#endif
+
+static_assert(XPT2046_MAX_REGIONS < 0xFFFF && XPT2046_REGION_ENTRIES < 0xFFFF,
+              "regions and cell entries are indexed with 16 bits");
+
+class TouchRegions
+{
+    public:
+        TouchRegions() { clear(); }
+        int  add(int x, int y, int w, int h, TouchHandler fn = nullptr, void *ctx = nullptr, uint8_t z = 0);
+        bool remove(int id);
+        void clear();
+        int  hitTest(int x, int y) const;
+        bool dispatch(const TouchEvent &ev) const;
+        static void onEvent(void *ctx, const TouchEvent &ev);
+
+    private:
+        using Region = struct treg
+        {
+            int16_t      x, y, w, h;  // w = 0 if the region is not in use
+            uint8_t      z;
+            uint16_t     seq;         // order of addition among equal z
+            TouchHandler fn;
+            void        *ctx;
+        };
+        using Entry = struct tent
+        {
+            uint16_t id;              // region
+            uint16_t next;            // next entry of the cell or the free list
+        };
+        static const uint16_t NONE = 0xFFFF;
+        Region   _region[XPT2046_MAX_REGIONS];
+        Entry    _entry[XPT2046_REGION_ENTRIES];
+        uint16_t _free;               // first unused entry
+        uint16_t _seq;
+        uint16_t _cell[XPT2046_REGION_CELLS][XPT2046_REGION_CELLS];  // first entry of each cell
+        bool     _above(int a, int b) const;
+        bool     _link(int id);
+        void     _unlink(int id);
+};
@@ -0,0 +1,87 @@
+/**
+ * File         XPT2046_Trace.cpp
+ *
+ * Purpose      Binary format of touch traces (see XPT2046_Trace.h)
+ */
+
+#include "XPT2046_Trace.h"
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+
+/**
+ * Writes the header into buf (XPT2046_TRACE_HEADER_SIZE bytes)
+ * and returns its size
+ */
+size_t packTraceHeader(uint8_t *buf)
+{
+    put16(buf, XPT2046_TRACE_MAGIC);
+    buf[2] = XPT2046_TRACE_VERSION;
+    buf[3] = XPT2046_TRACE_HEADER_SIZE;
+    buf[4] = XPT2046_TRACE_RECORD_SIZE;
+    buf[5] = buf[6] = buf[7] = 0;
+    return XPT2046_TRACE_HEADER_SIZE;
+}
+
+
+/**
+ * Checks the header and returns the sizes of header and record
+ */
+bool unpackTraceHeader(const uint8_t *buf, size_t len, size_t &headerSize, size_t &recordSize)
+{
+    if (len < XPT2046_TRACE_HEADER_SIZE || get16(buf) != XPT2046_TRACE_MAGIC) return false;
+    headerSize = buf[3];
+    recordSize = buf[4];
+    return headerSize >= XPT2046_TRACE_HEADER_SIZE && recordSize >= XPT2046_TRACE_RECORD_SIZE;
+}
+
+
+void packTraceRecord(const TraceRecord &r, uint32_t msPrevious, uint8_t *buf)
+{
+    uint32_t dt = r.ms - msPrevious;
+    put16(buf,     dt > 0xFFFF ? 0xFFFF : dt);
+    put16(buf + 2, (r.xValue & 0x7FFF) | (r.penDown ? 0x8000 : 0));
+    put16(buf + 4, r.yValue);
+    put16(buf + 6, r.zValue);
+}
+
+
+void unpackTraceRecord(const uint8_t *buf, uint32_t msPrevious, TraceRecord &r)
+{
+    uint16_t x = get16(buf + 2);
+    r.ms      = msPrevious + get16(buf);
+    r.penDown = (x & 0x8000) != 0;
+    r.xValue  = x & 0x7FFF;
+    r.yValue  = get16(buf + 4);
+    r.zValue  = get16(buf + 6);
+}
+
+
+/**
+ * Starts reading the trace in buf. The time of the
+ * records is counted from msStart.
+ */
+bool TraceReader::begin(const uint8_t *buf, size_t len, uint32_t msStart)
+{
+    size_t headerSize;
+    _p = _end = nullptr;
+    if (! unpackTraceHeader(buf, len, headerSize, _recordSize) || headerSize > len) return false;
+    _p   = buf + headerSize;
+    _end = buf + len;
+    _ms  = msStart;
+    return true;
+}
+
+
+/**
+ * Returns the next record, false at the end of the trace
+ */
+bool TraceReader::next(TraceRecord &r)
+{
+    if (! _p || (size_t)(_end - _p) < _recordSize) return false;
+    unpackTraceRecord(_p, _ms, r);
+    _ms = r.ms;
+    _p += _recordSize;
+    return true;
+}
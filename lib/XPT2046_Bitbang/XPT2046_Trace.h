@@ -0,0 +1,54 @@
+/**
+ * Header       XPT2046_Trace.h
+ *
+ * Purpose      Binary format of touch traces. A trace records the raw values
+ *              of the samples as they came from the XPT2046, so a misdetected
+ *              gesture or jitter can be reproduced later by replaying the trace
+ *              through the calibration and the gesture recognizer.
+ *                  header   uint16 magic, uint8 version, uint8 header size,
+ *                           uint8 record size, 3 bytes reserved
+ *                  records  uint16 ms since the previous record (saturated),
+ *                           uint16 xValue, bit 15 set if the pen is down,
+ *                           uint16 yValue, uint16 zValue, little endian
+ *              Readers skip header and record bytes they do not know, so
+ *              later versions may append fields.
+ *              TraceReader walks through a trace in memory, e.g. a file loaded
+ *              on a PC, and restores the absolute time of each record.
+ *
+ *              The header depends on the standard library only.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define XPT2046_TRACE_MAGIC        0x7854  // "Tx"
+#define XPT2046_TRACE_VERSION      1
+#define XPT2046_TRACE_HEADER_SIZE  8
+#define XPT2046_TRACE_RECORD_SIZE  8
+
+using TraceRecord = struct trec
+{
+    uint32_t ms;                      // time of the sample
+    bool     penDown;
+    uint16_t xValue, yValue, zValue;  // raw values
+};
+
+size_t packTraceHeader(uint8_t *buf);
+bool   unpackTraceHeader(const uint8_t *buf, size_t len, size_t &headerSize, size_t &recordSize);
+void   packTraceRecord(const TraceRecord &r, uint32_t msPrevious, uint8_t *buf);
+void   unpackTraceRecord(const uint8_t *buf, uint32_t msPrevious, TraceRecord &r);
+
+
+class TraceReader
+{
+    public:
+        bool begin(const uint8_t *buf, size_t len, uint32_t msStart = 0);
+        bool next(TraceRecord &r);
+
+    private:
+        const uint8_t *_p   = nullptr;
+        const uint8_t *_end = nullptr;
+        size_t   _recordSize = XPT2046_TRACE_RECORD_SIZE;
+        uint32_t _ms = 0;
+};
@@ -0,0 +1,156 @@
+/**
+ * File         XPT2046_Transport.cpp
+ *
+ * Purpose      Backends of the bus interface XPT2046_Transport:
+ *              software SPI (bit-bang) and hardware SPI
+ */
+
+#include "XPT2046_Transport.h"
+
+XPT2046_BitbangTransport::XPT2046_BitbangTransport(uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin) :
+                                                   _mosiPin(mosiPin), _misoPin(misoPin), _clkPin(clkPin), _csPin(csPin)
+{}
+
+
+/**
+ * Initialize the pins and the clock of the software SPI
+ */
+void XPT2046_BitbangTransport::begin()
+{
+    pinMode(_mosiPin, OUTPUT);
+    pinMode(_misoPin, INPUT);
+    pinMode(_clkPin, OUTPUT);
+    pinMode(_csPin, OUTPUT);
+    _mosi.attach(_mosiPin);
+    _miso.attach(_misoPin);
+    _clk.attach(_clkPin);
+    _cs.attach(_csPin);
+    _cs.high();
+    _clk.low();
+    setClockFrequency(_clockHz);
+}
+
+
+/**
+ * Sets the DCLK frequency of the bit-bang engine.
+ * The frequency is limited to XPT2046_MAX_CLOCK_HZ (2 MHz)
+ */
+void XPT2046_BitbangTransport::setClockFrequency(uint32_t hz)
+{
+    if (hz == 0) hz = XPT2046_DEFAULT_CLOCK_HZ;
+    if (hz > XPT2046_MAX_CLOCK_HZ) hz = XPT2046_MAX_CLOCK_HZ;
+    _clockHz = hz;
+    _halfPeriod = gpioCyclesPerSecond() / (2 * hz);
+    if (_halfPeriod == 0) _halfPeriod = 1;
+}
+
+
+void XPT2046_BitbangTransport::select()
+{ _cs.low(); }
+
+void XPT2046_BitbangTransport::deselect()
+{ _cs.high(); }
+
+
+/**
+ * Busy waits until the cycle counter reaches deadline
+ */
+inline void XPT2046_BitbangTransport::_waitUntil(uint32_t deadline)
+{
+    while ((int32_t)(gpioCycles() - deadline) < 0) {}
+}
+
+
+/**
+ * Write a command to the SPI
+ */
+void XPT2046_BitbangTransport::_writeSPI(uint8_t command)
+{
+    uint32_t t = gpioCycles();
+
+    for(int i = 7; i >= 0; i--)
+    {
+        _mosi.write(command & (1 << i));
+        _clk.low();
+        _waitUntil(t += _halfPeriod);
+        _clk.high();
+        _waitUntil(t += _halfPeriod);
+    }
+    _mosi.low();
+    _clk.low();
+}
+
+
+/**
+ * Write the command and read the result of the conversion
+ */
+uint16_t XPT2046_BitbangTransport::transfer(uint8_t command)
+{
+    _writeSPI(command);
+
+    uint32_t t = gpioCycles();
+    uint16_t result = 0;
+
+    for(int i = 15; i >= 0; i--)
+    {
+        _clk.high();
+        _waitUntil(t += _halfPeriod);
+        _clk.low();
+        _waitUntil(t += _halfPeriod);
+        result |= (_miso.read() << i);
+    }
+
+    return result >> 4;
+}
+
+
+
+XPT2046_SpiTransport::XPT2046_SpiTransport(SPIClass &spi, int8_t sclkPin, int8_t misoPin, int8_t mosiPin, uint8_t csPin) :
+                                           _spi(spi), _sclkPin(sclkPin), _misoPin(misoPin), _mosiPin(mosiPin), _csPin(csPin)
+{}
+
+
+/**
+ * Routes the pins to the SPI host. If the host was already
+ * started by another device, its pins are kept.
+ */
+void XPT2046_SpiTransport::begin()
+{
+    pinMode(_csPin, OUTPUT);
+    _cs.attach(_csPin);
+    _cs.high();
+    _spi.begin(_sclkPin, _misoPin, _mosiPin, -1);
+}
+
+
+void XPT2046_SpiTransport::setClockFrequency(uint32_t hz)
+{
+    if (hz == 0) hz = XPT2046_DEFAULT_CLOCK_HZ;
+    if (hz > XPT2046_MAX_CLOCK_HZ) hz = XPT2046_MAX_CLOCK_HZ;
+    _clockHz = hz;
+}
+
+
+void XPT2046_SpiTransport::select()
+{
+    _spi.beginTransaction(SPISettings(_clockHz, MSBFIRST, SPI_MODE0));
+    _cs.low();
+}
+
+
+void XPT2046_SpiTransport::deselect()
+{
+    _cs.high();
+    _spi.endTransaction();
+}
+
+
+/**
+ * The result follows the busy bit and is left aligned
+ * in the 16 bits clocked after the command
+ */
+uint16_t XPT2046_SpiTransport::transfer(uint8_t command)
+{
+    _spi.transfer(command);
+    return _spi.transfer16(0) >> 3;
+}
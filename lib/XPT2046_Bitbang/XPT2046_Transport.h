@@ -0,0 +1,84 @@
+/**
+ * Header       XPT2046_Transport.h
+ *
+ * Purpose      Declaration of the bus interface used by XPT2046_Bitbang to talk
+ *              to the touch controller and of its backends:
+ *                - XPT2046_BitbangTransport  software SPI on any pins (default)
+ *                - XPT2046_SpiTransport      hardware SPI of the ESP32, the pins
+ *                                            are routed through the GPIO matrix
+ *              A transfer sends a command byte and returns the 12 bit result
+ *              of the conversion. Several transfers may be made between
+ *              select() and deselect().
+ *
+ * Remarks      On the CYD both free SPI hosts are in use (HSPI by the display,
+ *              VSPI by the SD card), so the hardware backend is only an option
+ *              if the SD card is not used or if the touch controller shares the
+ *              bus of another device. In the latter case pass the SPIClass of
+ *              that bus, the transactions keep the devices apart.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <SPI.h>
+#include "XPT2046_Gpio.h"
+
+class XPT2046_Transport
+{
+    public:
+        virtual ~XPT2046_Transport() {}
+        virtual void begin() = 0;
+        virtual void setClockFrequency(uint32_t hz) = 0;
+        virtual void select() = 0;
+        virtual void deselect() = 0;
+        virtual uint16_t transfer(uint8_t command) = 0;
+        virtual const char *name() = 0;
+};
+
+
+class XPT2046_BitbangTransport : public XPT2046_Transport
+{
+    public:
+        XPT2046_BitbangTransport(uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin);
+        void begin() override;
+        void setClockFrequency(uint32_t hz) override;
+        void select() override;
+        void deselect() override;
+        uint16_t transfer(uint8_t command) override;
+        const char *name() override { return "bitbang"; }
+
+    private:
+        uint8_t _mosiPin;
+        uint8_t _misoPin;
+        uint8_t _clkPin;
+        uint8_t _csPin;
+        GpioPin _mosi;
+        GpioPin _miso;
+        GpioPin _clk;
+        GpioPin _cs;
+        uint32_t _clockHz = XPT2046_DEFAULT_CLOCK_HZ;
+        uint32_t _halfPeriod = 1;  // half DCLK period in cycles of gpioCycles()
+        inline void _waitUntil(uint32_t deadline);
+        void _writeSPI(uint8_t command);
+};
+
+
+class XPT2046_SpiTransport : public XPT2046_Transport
+{
+    public:
+        XPT2046_SpiTransport(SPIClass &spi, int8_t sclkPin, int8_t misoPin, int8_t mosiPin, uint8_t csPin);
+        void begin() override;
+        void setClockFrequency(uint32_t hz) override;
+        void select() override;
+        void deselect() override;
+        uint16_t transfer(uint8_t command) override;
+        const char *name() override { return "hwspi"; }
+
+    private:
+        SPIClass &_spi;
+        int8_t   _sclkPin;
+        int8_t   _misoPin;
+        int8_t   _mosiPin;
+        uint8_t  _csPin;
+        GpioPin  _cs;
+        uint32_t _clockHz = XPT2046_MAX_CLOCK_HZ;
+};
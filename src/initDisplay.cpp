@@ -6,7 +6,7 @@
 
 using Action = void(&)(LGFX &lcd);
 GFXfont defaultFont = fonts::DejaVu18;
-void nop(LGFX &lcd){};
+void nop(LGFX &lcd) { (void)lcd; }
 
 /**
  * Calibration routine used with LGFX touch functions
@@ -32,6 +32,14 @@ extern void initDisplay(LGFX &lcd, uint8_t rotation=0, GFXfont *theFont=&default
 extern void initSDCard(SPIClass &spi);
 extern void framedCrosshair(LGFX &lcd);
 extern bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename);
+extern bool saveBMPtoSD_rle8(LGFX &lcd, const char *filename);
+extern bool startRecording(LGFX &lcd, const char *filename);
+extern bool recordFrame(LGFX &lcd);
+extern bool stopRecording();
+
+#ifndef SCREEN_RECORDING
+  #define SCREEN_RECORDING 0  // 1 records the calibration menu to /calibration.cdr
+#endif
 
 enum class ROTATION { LANDSCAPE_USB_RIGHT, PORTRAIT_USB_UP, LANDSCAPE_USB_LEFT, PORTRAIT_USB_DOWN };
 
@@ -40,71 +48,96 @@ XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
 SPIClass sdcardSPI(VSPI);
 
 // These points are used for calibration when called with useCalibrationPoints()
-TouchPoint calibrationPoints[] = {{ 90,  50, 0,0,0},   // upper left point
-                                  {290, 210, 0,0,0}};  // lower right point
+// With 3 or more points rotation and skew of the touchpad are corrected too
+TouchPoint calibrationPoints[] = {{ 90,  50, 0,0,0,0},   // upper left point
+                                  {290, 210, 0,0,0,0},   // lower right point
+                                  {290,  50, 0,0,0,0},   // upper right point
+                                  { 90, 210, 0,0,0,0}};  // lower left point
+const int nbrCalibrationPoints = sizeof(calibrationPoints) / sizeof(calibrationPoints[0]);
+
+// Handlers of the menu items in checkTouchpadCalibration()
+void onCalibrate(void *ctx, const TouchEvent &ev)          { touchpad.useCalibrationPoints(calibrationPoints, nbrCalibrationPoints, 5); }
+void onClearCalibrationData(void *ctx, const TouchEvent &ev) { touchpad.clearCalibrationData(); }
+void onErasePreferences(void *ctx, const TouchEvent &ev)   { if (SCREEN_RECORDING) stopRecording(); touchpad.erasePreferences(true); }
+void onUseDefaults(void *ctx, const TouchEvent &ev)        { touchpad.saveCalibrationData(); }
+void onContinue(void *ctx, const TouchEvent &ev)           { if (SCREEN_RECORDING) stopRecording(); lcd.clear(); *static_cast<bool *>(ctx) = true; }
+void onScreenshot(void *ctx, const TouchEvent &ev)         { saveBMPtoSD_rle8(lcd, static_cast<const char *>(ctx)); }
 
 void checkTouchpadCalibration()
 {
   int x,y;
   bool done = false;
+  static TouchRegions menu;   // about 2 KB, kept off the stack of the loop task
 
   while (! done)
   {
+    grid(lcd, lcd.width(), lcd.height(), 20);  // new calibration data takes effect without restart, so repaint the menu
+    menu.clear();
     if (touchpad.isCalibrationDataAvailable())
     {
       touchpad.recallCalibrationData();
       touchpad.printCalibrationData();
       lcd.setCursor(30, 20);  lcd.print(" Touchpad is calibrated ");
-      lcd.setCursor(30, 80);  lcd.print(" Recalibrate? ");             //40..160,90
-      lcd.setCursor(30, 100); lcd.print(" Clear calibration data? ");  //40..260,110
-      lcd.setCursor(30, 120); lcd.print(" Clear prefs and restart? "); //40..270,130
-      lcd.setCursor(30, 140); lcd.print(" Continue? ");                //40..150,150
-      while (! touchpad.getTouch(x, y)) delay(100);
-      vTaskDelay(pdMS_TO_TICKS(500));
-      if     (touchpad.touchedAt(x, y, 100,  90,  60, 10)) touchpad.useCalibrationPoints(calibrationPoints, 5);
-      else if(touchpad.touchedAt(x, y, 150, 110, 110, 10)) touchpad.clearCalibrationData();
-      else if(touchpad.touchedAt(x, y, 155, 130, 115, 10)) touchpad.erasePreferences();
-      else if(touchpad.touchedAt(x, y,  95, 150,  55, 10)) {lcd.clear(); done = true; }
-      else if(touchpad.touchedAt(x, y, 60,60,5,5)) saveBMPtoSD_24bit(lcd, "/calibrated.bmp");
+      lcd.setCursor(30, 80);  lcd.print(" Recalibrate? ");             menu.add(40,  80, 120, 20, onCalibrate);
+      lcd.setCursor(30, 100); lcd.print(" Clear calibration data? ");  menu.add(40, 100, 220, 20, onClearCalibrationData);
+      lcd.setCursor(30, 120); lcd.print(" Clear prefs and restart? "); menu.add(40, 120, 230, 20, onErasePreferences);
+      lcd.setCursor(30, 140); lcd.print(" Continue? ");                menu.add(40, 140, 110, 20, onContinue, &done);
+      menu.add(55, 55, 10, 10, onScreenshot, (void *)"/calibrated.bmp");
     }
     else
     {
       lcd.setCursor(30, 20);  lcd.print(" Touchpad is not calibrated ");
-      lcd.setCursor(30, 80);  lcd.print(" Calibrate? ");                // 40..140,90
-      lcd.setCursor(30, 100); lcd.print(" Use programmed defaults? ");  // 40..300,110
-      while (! touchpad.getTouch(x, y)) delay(100);
-      vTaskDelay(pdMS_TO_TICKS(500));
-      if     (touchpad.touchedAt(x, y,  90,  90,  50, 10)) touchpad.useCalibrationPoints(calibrationPoints, 5);
-      else if(touchpad.touchedAt(x, y, 170, 110, 130, 10)) touchpad.saveCalibrationData();
-      else if(touchpad.touchedAt(x, y, 60,60,5,5)) saveBMPtoSD_24bit(lcd, "/uncalibrated.bmp");
+      lcd.setCursor(30, 80);  lcd.print(" Calibrate? ");                menu.add(40,  80, 100, 20, onCalibrate);
+      lcd.setCursor(30, 100); lcd.print(" Use programmed defaults? ");  menu.add(40, 100, 260, 20, onUseDefaults);
+      menu.add(55, 55, 10, 10, onScreenshot, (void *)"/uncalibrated.bmp");
+    }
+    if (SCREEN_RECORDING) recordFrame(lcd);
+    while (! touchpad.getTouch(x, y))
+    {
+      if (touchpad.isPenDown()) delay(10);  // PENIRQ is low, but the touch is too light
+      else touchpad.waitForTouch(100);
     }
+    vTaskDelay(pdMS_TO_TICKS(500));
+    menu.dispatch(TouchEvent {TOUCH_SHORT, x, y});
     touchpad.printCalibrationData(); 
   } 
 }
 
 
+// Shows the coordinates while the pen is down or moving
+void onPenMove(void *ctx, const TouchEvent &ev)
+{
+  lcd.fillRect(0, 205, 320, 40, TFT_BLACK);
+  lcd.setCursor(10,220);
+  lcd.printf("x = %d, y = %d", ev.x, ev.y);
+  log_i("x / y = %d / %d  v = %d / %d px/s", ev.x, ev.y, ev.vx, ev.vy);
+}
+
+
 void setup() 
 {
   Serial.begin(115200);
   initDisplay(lcd, static_cast<uint8_t>(ROTATION::LANDSCAPE_USB_RIGHT), &defaultFont, grid);
   initSDCard(sdcardSPI);
   touchpad.begin();
-  checkTouchpadCalibration();
+  touchpad.useIrq(TP_IRQ);
+  if (SCREEN_RECORDING) startRecording(lcd, "/calibration.cdr");
+  checkTouchpadCalibration();  // Continue and the restart stop the recording
   lcd.clear();
   grid(lcd, lcd.width(), lcd.height()-39, 20);
+  touchpad.subscribe(TOUCH_PEN_DOWN, onPenMove);
+  touchpad.subscribe(TOUCH_MOVE, onPenMove);
 }
 
 
 void loop() 
 {
-  TouchPoint tpoint;
+  static uint32_t msLog = 0;
 
-  if (touchpad.getTouch(tpoint))
+  touchpad.loop();  // samples fast while touched, backs off or waits for PENIRQ when idle
+  if (millis() - msLog > 5000)
   {
-    lcd.fillRect(0, 205, 320, 40, TFT_BLACK);
-    lcd.setCursor(10,220);
-    lcd.printf("x = %d, y = %d", tpoint.x, tpoint.y);
-    log_i("x / y = %d / %d  xValue / yValue = %d / %d", tpoint.x, tpoint.y, tpoint.xValue, tpoint.yValue);
-    delay(200);
-  }   
+    msLog = millis();
+    log_i("%u samples/s, %u%% idle", (unsigned)touchpad.getSampleRate(), (unsigned)touchpad.getIdleCpuPercent());
+  }
 }
@@ -0,0 +1,233 @@
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <vector>
+#include <LovyanGFX.hpp>
+#include "lgfx_ESP32_2432S028.h"
+
+/**
+ * Screen recording to SD card. startRecording() writes a keyframe with
+ * all tiles of the screen, every call of recordFrame() afterwards writes
+ * only the tiles that changed. A tile is RECORD_TILE_SIZE pixels square,
+ * a change is detected by a 32 bit hash over its pixels, so the whole
+ * screen is read but only the changed parts go to the SD card. Every
+ * RECORD_KEYFRAME_INTERVAL frames a keyframe is written again, so a
+ * frame can be restored without reading the recording from the start.
+ *
+ * The file is only appended to, all values little endian:
+ *   header   "CYDR", uint8 version, uint8 header size, uint16 width,
+ *            uint16 height, uint8 tile size, uint8 bytes per pixel,
+ *            4 bytes reserved
+ *   frame    'F', uint8 flags (bit 0 keyframe), 2 bytes reserved,
+ *            uint32 ms since the start of the recording, then the tiles:
+ *            uint16 tile number (row by row), the pixels of the tile top
+ *            down in the order b,g,r of a 24-bit BMP, clipped at the right
+ *            and the bottom edge. The tile number 0xFFFF ends the frame.
+ *   index    written by stopRecording(): 'I', 3 bytes reserved,
+ *            uint32 number of frames, uint32 file offset of each frame
+ *   trailer  uint32 file offset of the index, "CYDX"
+ * A recording without index, e.g. after a reset, can still be read
+ * frame by frame. tools/cydrec.py converts a recording to BMP files.
+ */
+
+#ifndef RECORD_TILE_SIZE
+  #define RECORD_TILE_SIZE 16
+#endif
+#ifndef RECORD_KEYFRAME_INTERVAL
+  #define RECORD_KEYFRAME_INTERVAL 50
+#endif
+#define RECORD_VERSION     1
+#define RECORD_HEADER_SIZE 16
+#define RECORD_END_OF_FRAME 0xFFFF
+#define RECORD_OUT_BUFFER  4096
+
+extern void rotate_rgb888(lgfx::rgb888_t* buf, int bufSize);
+
+using Recorder = struct rec
+{
+  File      file;
+  int       width, height;
+  int       tilesX, tilesY;
+  uint32_t *hash;          // of each tile in the last frame
+  uint8_t  *band;          // one row of tiles
+  uint8_t  *out;           // collects the small pieces for the SD card
+  size_t    fill;
+  uint32_t  offset;        // file position of the next byte
+  uint32_t  msStart;
+  std::vector<uint32_t> index;
+  bool      ok;
+};
+
+static Recorder rec = {};
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+
+
+static void flushOut()
+{
+  if (rec.fill) rec.ok = rec.ok && rec.file.write(rec.out, rec.fill) == rec.fill;
+  rec.fill = 0;
+}
+
+
+static void put(const uint8_t *data, size_t len)
+{
+  if (rec.fill + len > RECORD_OUT_BUFFER) flushOut();
+  memcpy(rec.out + rec.fill, data, len);
+  rec.fill   += len;
+  rec.offset += len;
+}
+
+
+/**
+ * Hashes the pixels of a tile, rows of rowBytes bytes, stride
+ * bytes apart. Works on 32 bit words, the tail byte by byte.
+ */
+static uint32_t hashTile(const uint8_t *p, int stride, int rowBytes, int rows)
+{
+  uint32_t h = 2166136261u;
+  for (int r = 0; r < rows; r++, p += stride)
+  {
+    int k = 0;
+    for (; k + 4 <= rowBytes; k += 4)
+    {
+      uint32_t w;
+      memcpy(&w, p + k, 4);
+      h = (h ^ w) * 0x9E3779B1u;
+      h ^= h >> 15;
+    }
+    for (; k < rowBytes; k++) h = (h ^ p[k]) * 16777619u;
+  }
+  return h;
+}
+
+
+static void freeRecorder()
+{
+  if (rec.hash) heap_caps_free(rec.hash);
+  if (rec.band) heap_caps_free(rec.band);
+  if (rec.out)  heap_caps_free(rec.out);
+  rec.hash = nullptr;
+  rec.band = rec.out = nullptr;
+  std::vector<uint32_t>().swap(rec.index);
+}
+
+
+/**
+ * Appends a frame with the tiles changed since the last frame, all
+ * tiles if it is a keyframe. Call it whenever the screen may have
+ * changed, e.g. periodically in loop().
+ */
+bool recordFrame(LGFX &lcd)
+{
+  if (! rec.file || ! rec.ok) return false;
+  if (lcd.width() != rec.width || lcd.height() != rec.height)
+  {
+    log_e("==> the rotation of the screen has changed");
+    return false;
+  }
+  uint32_t ms = millis();
+  bool key = rec.index.size() % RECORD_KEYFRAME_INTERVAL == 0;
+  int lineSize = 3 * rec.width;
+  int changed = 0;
+  uint8_t b[8] = {'F', (uint8_t)(key ? 1 : 0), 0, 0};
+
+  rec.index.push_back(rec.offset);
+  put32(b + 4, ms - rec.msStart);
+  put(b, 8);
+  for (int ty = 0; ty < rec.tilesY; ty++)
+  {
+    int y = ty * RECORD_TILE_SIZE;
+    int h = std::min(RECORD_TILE_SIZE, rec.height - y);
+    lcd.readRect(0, y, rec.width, h, (lgfx::rgb888_t *)rec.band);
+    rotate_rgb888((lgfx::rgb888_t *)rec.band, h * lineSize);
+    for (int tx = 0; tx < rec.tilesX; tx++)
+    {
+      int x = tx * RECORD_TILE_SIZE;
+      int w = std::min(RECORD_TILE_SIZE, rec.width - x);
+      int n = ty * rec.tilesX + tx;
+      uint32_t hash = hashTile(rec.band + 3 * x, lineSize, 3 * w, h);
+      if (! key && hash == rec.hash[n]) continue;
+      rec.hash[n] = hash;
+      changed++;
+      put16(b, n);
+      put(b, 2);
+      for (int r = 0; r < h; r++) put(rec.band + r * lineSize + 3 * x, 3 * w);
+    }
+  }
+  put16(b, RECORD_END_OF_FRAME);
+  put(b, 2);
+  flushOut();
+  rec.file.flush();  // the frames written so far survive a reset
+  log_d("==> frame %u, %d tiles in %u ms", (unsigned)rec.index.size() - 1, changed, (unsigned)(millis() - ms));
+  return rec.ok;
+}
+
+
+/**
+ * Creates the recording and writes the first keyframe
+ */
+bool startRecording(LGFX &lcd, const char *filename)
+{
+  if (rec.file) return false;
+  rec.width  = lcd.width();
+  rec.height = lcd.height();
+  rec.tilesX = (rec.width  + RECORD_TILE_SIZE - 1) / RECORD_TILE_SIZE;
+  rec.tilesY = (rec.height + RECORD_TILE_SIZE - 1) / RECORD_TILE_SIZE;
+  rec.hash = (uint32_t *)heap_caps_malloc(rec.tilesX * rec.tilesY * sizeof(uint32_t), MALLOC_CAP_8BIT);
+  rec.band = (uint8_t *)heap_caps_malloc(RECORD_TILE_SIZE * 3 * rec.width, MALLOC_CAP_DMA);
+  rec.out  = (uint8_t *)heap_caps_malloc(RECORD_OUT_BUFFER, MALLOC_CAP_8BIT);
+  if (! rec.hash || ! rec.band || ! rec.out)
+  {
+    log_e("==> no memory for the recording");
+    freeRecorder();
+    return false;
+  }
+  rec.file = SD.open(filename, "w");
+  if (! rec.file)
+  {
+    Serial.print("error:file open failure\n");
+    freeRecorder();
+    return false;
+  }
+  rec.fill    = 0;
+  rec.offset  = 0;
+  rec.msStart = millis();
+  rec.ok      = true;
+
+  uint8_t header[RECORD_HEADER_SIZE] = {'C', 'Y', 'D', 'R', RECORD_VERSION, RECORD_HEADER_SIZE};
+  put16(header + 6, rec.width);
+  put16(header + 8, rec.height);
+  header[10] = RECORD_TILE_SIZE;
+  header[11] = 3;
+  put(header, sizeof(header));
+  return recordFrame(lcd);
+}
+
+
+/**
+ * Appends the index of the frames and closes the recording
+ */
+bool stopRecording()
+{
+  if (! rec.file) return false;
+  uint32_t indexOffset = rec.offset;
+  uint8_t b[8] = {'I', 0, 0, 0};
+  put32(b + 4, rec.index.size());
+  put(b, 8);
+  for (uint32_t offset : rec.index)
+  {
+    put32(b, offset);
+    put(b, 4);
+  }
+  put32(b, indexOffset);
+  memcpy(b + 4, "CYDX", 4);
+  put(b, 8);
+  flushOut();
+  log_i("==> %s: %u frames, %u bytes", rec.file.name(), (unsigned)rec.index.size(), (unsigned)rec.offset);
+  rec.file.close();
+  freeRecorder();
+  return rec.ok;
+}
@@ -1,5 +1,7 @@
 #include <Arduino.h>
 #include <SD.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
 #include <LovyanGFX.hpp>
 #include "lgfx_ESP32_2432S028.h"
 
@@ -9,8 +11,331 @@
  * https://github.com/lovyan03/LovyanGFX/tree/master/examples/Standard/SaveBMP
  * The order of the colors must be rotated to obtain 
  * the same colors in the file as on the screen. 
+ *
+ * The screen is read in bands of several rows into two buffers in DMA 
+ * capable RAM, the band height depends on the free memory and is limited 
+ * by SCREENSHOT_MAX_BAND_BYTES for both buffers together. Fewer and larger 
+ * transfers save most of the time. While one band is read from the panel, 
+ * a task on the other core writes the previous one to the SD card. 
+ * The file is written in multiples of the SD sector size of 512 bytes.
+ *
+ * saveBMPtoSD_rle8() compresses the screen on the fly with BI_RLE8,
+ * it needs a band buffer and a palette of about 3.5 kB only.
  */
 
+#ifndef SCREENSHOT_MAX_BAND_BYTES
+  #define SCREENSHOT_MAX_BAND_BYTES 16384
+#endif
+#define SD_SECTOR_SIZE 512
+
+
+/**
+ * Collects the data written to the file in a sector buffer,
+ * so that every write to the SD card, except the last one, 
+ * is a multiple of 512 bytes at a sector boundary
+ */
+class SectorWriter
+{
+  public:
+    SectorWriter(File &file) : _file(file) {}
+
+    bool write(const uint8_t *data, size_t len)
+    {
+      if (_fill > 0)
+      { // complete the pending sector first
+        size_t n = std::min(len, SD_SECTOR_SIZE - _fill);
+        memcpy(_sector + _fill, data, n);
+        _fill += n; data += n; len -= n;
+        if (_fill < SD_SECTOR_SIZE) return _ok;
+        _ok = _ok && _file.write(_sector, SD_SECTOR_SIZE) == SD_SECTOR_SIZE;
+        _fill = 0;
+      }
+      size_t whole = len & ~(size_t)(SD_SECTOR_SIZE - 1);
+      if (whole) _ok = _ok && _file.write(data, whole) == whole;
+      memcpy(_sector, data + whole, len - whole);
+      _fill = len - whole;
+      return _ok;
+    }
+
+    bool flush()
+    {
+      if (_fill) _ok = _ok && _file.write(_sector, _fill) == _fill;
+      _fill = 0;
+      return _ok;
+    }
+
+  private:
+    File   &_file;
+    uint8_t _sector[SD_SECTOR_SIZE];
+    size_t  _fill = 0;
+    bool    _ok = true;
+};
+
+
+/**
+ * Allocates a band buffer in DMA capable RAM. It takes at most half of 
+ * the largest free block and maxBytes, but at least one row. Returns 
+ * the number of rows in the band or 0 if there is no memory.
+ */
+static int allocBand(uint8_t *&band, int rowSize, int height, size_t maxBytes)
+{
+  size_t size = std::min(heap_caps_get_largest_free_block(MALLOC_CAP_DMA) / 2, maxBytes);
+  int rows = std::max(1, std::min(height, (int)(size / rowSize)));
+  band = (uint8_t *)heap_caps_malloc(rows * rowSize, MALLOC_CAP_DMA);
+  if (! band && rows > 1)
+  {
+    rows = 1;
+    band = (uint8_t *)heap_caps_malloc(rowSize, MALLOC_CAP_DMA);
+  }
+  return band ? rows : 0;
+}
+
+
+/**
+ * The panel (HSPI) and the SD card (VSPI) are on different buses, so the
+ * next band can be read while the previous one is written. A writer task 
+ * on the other core receives the filled bands through the queue full and 
+ * returns the written buffers through the queue empty. A band of size 0 
+ * ends the writer, it answers with a band without data on empty. The 
+ * caller's task notification is left alone, it may belong to PENIRQ.
+ */
+using Band = struct bnd
+{
+  uint8_t *data;
+  int      size;
+};
+
+using BandPipe = struct bpip
+{
+  QueueHandle_t full;
+  QueueHandle_t empty;
+  SectorWriter *out;
+  volatile bool ok;
+};
+
+static void bandWriterTask(void *arg)
+{
+  BandPipe *pipe = static_cast<BandPipe *>(arg);
+  Band band;
+  while (xQueueReceive(pipe->full, &band, portMAX_DELAY) == pdTRUE && band.size > 0)
+  {
+    if (! pipe->out->write(band.data, band.size)) pipe->ok = false;
+    xQueueSend(pipe->empty, &band, portMAX_DELAY);
+  }
+  band = {nullptr, 0};
+  xQueueSend(pipe->empty, &band, portMAX_DELAY);
+  vTaskDelete(nullptr);
+}
+
+
+/**
+ * Creates the queues and the writer task, spare is the
+ * second buffer. Returns false if a resource is missing.
+ */
+static bool startBandWriter(BandPipe &pipe, SectorWriter &out, uint8_t *spare)
+{
+  pipe = BandPipe {xQueueCreate(2, sizeof(Band)), xQueueCreate(2, sizeof(Band)), &out, true};
+  if (pipe.full && pipe.empty)
+  {
+    Band band = {spare, 0};
+    xQueueSend(pipe.empty, &band, 0);
+    if (xTaskCreatePinnedToCore(bandWriterTask, "bmpwrite", 4096, &pipe, uxTaskPriorityGet(nullptr), 
+                                nullptr, 1 - xPortGetCoreID()) == pdPASS) return true;
+  }
+  if (pipe.full)  vQueueDelete(pipe.full);
+  if (pipe.empty) vQueueDelete(pipe.empty);
+  return false;
+}
+
+
+/**
+ * Hands the filled band over to the writer 
+ * and returns an empty buffer
+ */
+static uint8_t *passBand(BandPipe &pipe, uint8_t *data, int size)
+{
+  Band band = {data, size};
+  xQueueSend(pipe.full, &band, portMAX_DELAY);
+  xQueueReceive(pipe.empty, &band, portMAX_DELAY);
+  return band.data;
+}
+
+
+/**
+ * Waits until the writer has written all bands, the buffers 
+ * returned before its answer are dropped
+ */
+static bool stopBandWriter(BandPipe &pipe)
+{
+  Band band = {nullptr, 0};
+  xQueueSend(pipe.full, &band, portMAX_DELAY);
+  do
+  {
+    xQueueReceive(pipe.empty, &band, portMAX_DELAY);
+  } while (band.data);
+  vQueueDelete(pipe.full);
+  vQueueDelete(pipe.empty);
+  return pipe.ok;
+}
+
+
+/**
+ * Color kernels, they rotate the channels of the pixels read from the 
+ * panel to get the same colors in the file as on the screen. Several 
+ * pixels are rotated per 32 bit word, the tail of a row pixel by pixel. 
+ *   RGB565  2 pixels per word, each rotated left by 5 bits. The 6 bits 
+ *           of green land in the 6 bit field of red, nothing is lost.
+ *   RGB888  4 pixels in 3 words, the bytes b,g,r of each pixel become r,b,g
+ */
+struct Swizzle565
+{
+  static const int PIXEL = 2;
+  static const int GROUP = 4;
+
+  static void group(uint8_t *dst, const uint8_t *src)
+  {
+    uint32_t w;
+    memcpy(&w, src, 4);
+    w = ((w << 5) & 0xFFE0FFE0) | ((w >> 11) & 0x001F001F);
+    memcpy(dst, &w, 4);
+  }
+
+  static void pixel(uint8_t *dst, const uint8_t *src)
+  {
+    uint16_t v;
+    memcpy(&v, src, 2);
+    v = (v << 5) | (v >> 11);
+    memcpy(dst, &v, 2);
+  }
+};
+
+struct Swizzle888
+{
+  static const int PIXEL = 3;
+  static const int GROUP = 12;
+
+  static void group(uint8_t *dst, const uint8_t *src)
+  {
+    uint32_t w0, w1, w2;
+    memcpy(&w0, src, 4);
+    memcpy(&w1, src + 4, 4);
+    memcpy(&w2, src + 8, 4);
+    uint32_t o0 = ((w0 >> 16) & 0x000000FF) | ((w0 <<  8) & 0x00FFFF00) | ((w1 << 16) & 0xFF000000);
+    uint32_t o1 =  (w0 >> 24)               | ((w1 <<  8) & 0xFF00FF00) | ((w2 << 16) & 0x00FF0000);
+    uint32_t o2 =  (w1 >> 24)               | ((w2 >> 16) & 0x0000FF00) | ((w2 <<  8) & 0xFFFF0000);
+    memcpy(dst, &o0, 4);
+    memcpy(dst + 4, &o1, 4);
+    memcpy(dst + 8, &o2, 4);
+  }
+
+  static void pixel(uint8_t *dst, const uint8_t *src)
+  {
+    uint8_t b = src[0], g = src[1], r = src[2];
+    dst[0] = r;
+    dst[1] = b;
+    dst[2] = g;
+  }
+};
+
+
+/**
+ * Rotates the colors of the rows a and b of lineSize bytes and swaps
+ * them. Both rows are read and written once. With a == b the row is
+ * only rotated.
+ */
+template <typename K>
+static void swizzleRows(uint8_t *a, uint8_t *b, int lineSize)
+{
+  uint8_t ta[K::GROUP], tb[K::GROUP];
+  int k = 0;
+  if (a == b)
+  {
+    for (; k + K::GROUP <= lineSize; k += K::GROUP) K::group(a + k, a + k);
+    for (; k < lineSize; k += K::PIXEL) K::pixel(a + k, a + k);
+    return;
+  }
+  for (; k + K::GROUP <= lineSize; k += K::GROUP)
+  {
+    K::group(ta, a + k);
+    K::group(tb, b + k);
+    memcpy(a + k, tb, K::GROUP);
+    memcpy(b + k, ta, K::GROUP);
+  }
+  for (; k < lineSize; k += K::PIXEL)
+  {
+    K::pixel(ta, a + k);
+    K::pixel(tb, b + k);
+    memcpy(a + k, tb, K::PIXEL);
+    memcpy(b + k, ta, K::PIXEL);
+  }
+}
+
+
+/**
+ * Converts nRows rows read top down with lineSize bytes each into 
+ * the order and the colors of the BMP file: bottom up, rotated 
+ * and padded to rowSize bytes
+ */
+template <typename K>
+static void bandToFileOrder(uint8_t *band, int nRows, int lineSize, int rowSize)
+{
+  if (rowSize != lineSize)
+  {
+    for (int i = nRows - 1; i >= 0; i--)
+    {
+      memmove(band + i * rowSize, band + i * lineSize, lineSize);
+      memset(band + i * rowSize + lineSize, 0, rowSize - lineSize);
+    }
+  }
+  for (int i = 0, j = nRows - 1; i <= j; i++, j--)
+  {
+    swizzleRows<K>(band + i * rowSize, band + j * rowSize, lineSize);
+  }
+}
+
+
+/**
+ * Reads the screen band by band from the bottom up, rotates the colors
+ * with the kernel K and writes the bands to the file. With two buffers 
+ * the bands are written by a task on the other core while the next band 
+ * is read, otherwise reading and writing alternate.
+ */
+template <typename T, typename K>
+static bool writeBands(LGFX &lcd, SectorWriter &out, int &rows)
+{
+  int width    = lcd.width();
+  int height   = lcd.height();
+  int lineSize = sizeof(T) * width;
+  int rowSize  = (lineSize + 3) & ~3;
+  uint8_t *band[2] = {nullptr, nullptr};
+  BandPipe pipe;
+  bool ok = true;
+
+  rows = allocBand(band[0], rowSize, height, SCREENSHOT_MAX_BAND_BYTES / 2);
+  if (rows == 0) return false;
+  if (allocBand(band[1], rowSize, rows, SCREENSHOT_MAX_BAND_BYTES / 2) < rows && band[1])
+  {
+    heap_caps_free(band[1]);
+    band[1] = nullptr;
+  }
+  bool pipelined = band[1] && startBandWriter(pipe, out, band[1]);
+
+  uint8_t *buf = band[0];
+  for (int yEnd = height; yEnd > 0 && ok; yEnd -= rows)
+  {
+    int n = std::min(rows, yEnd);
+    lcd.readRect(0, yEnd - n, width, n, (T*)buf);
+    bandToFileOrder<K>(buf, n, lineSize, rowSize);
+    if (pipelined) buf = passBand(pipe, buf, n * rowSize);
+    else ok = out.write(buf, n * rowSize);
+  }
+  if (pipelined) ok = stopBandWriter(pipe) && ok;
+  heap_caps_free(band[0]);
+  if (band[1]) heap_caps_free(band[1]);
+  return ok;
+}
+
+
 /**
  * Helper function to explore the content 
  * of the color buffer
@@ -29,34 +354,22 @@ void printBuf565(lgfx::rgb565_t* buf, int bufSize)
 /**
  * Rotate the colors to get the right sequence  
  * in the picture saved to SD card.
- * Because the color green, originally represented with 
- * 6 bits, is now stored in the bit field of RED with 
- * 5 bits, color information is lost. 
+ * The 6 bits of green are moved to the 6 bit field 
+ * of red, the file declares the fields with masks.
  */
 void rotate_rgb565(lgfx::rgb565_t* buf, int bufSize)
 {
-  auto  rotateTuple = [](lgfx::rgb565_t* pRGB) 
-        {  
-          lgfx::rgb565_t tmp = *pRGB;
-          pRGB->r5 = tmp.g6;
-          pRGB->g6 = tmp.b5<<1;  // 1 bit of color information gets lost
-          pRGB->b5 = tmp.r5;
-        };
-  int nTuples = bufSize / 2;
-  for (int i = 0; i < nTuples; i++)
-  {
-    rotateTuple(buf);
-    buf++;
-  }  
+  uint8_t *p = (uint8_t *)buf;
+  swizzleRows<Swizzle565>(p, p, bufSize & ~1);
 }
 
 /**
  * Saves the LCD screen to SD card in RGB565 format. 
  * The order of the colors must be rotated to obtain 
  * the same colors in the file as on the screen.
- * Because the color green, originally represented with 
- * 6 bits, is now stored in the bit field of RED with 
- * 5 bits, color information is lost. 
+ * The file has BI_BITFIELDS compression with the masks 
+ * 6-5-5 following the header, so all bits of the 
+ * screen are kept.
  */
 bool saveBMPtoSD_16bit(LGFX &lcd, const char *filename)
 {
@@ -68,11 +381,13 @@ bool saveBMPtoSD_16bit(LGFX &lcd, const char *filename)
     int height = lcd.height();
 
     int rowSize = (2 * width + 3) & ~ 3;
+    const uint32_t masks[3] = {0xFC00, 0x03E0, 0x001F};  // red, green, blue
 
     lgfx::bitmap_header_t bmpheader;
+    memset(&bmpheader, 0, sizeof(bmpheader));
     bmpheader.bfType = 0x4D42;
-    bmpheader.bfSize = rowSize * height + sizeof(bmpheader);
-    bmpheader.bfOffBits = sizeof(bmpheader);
+    bmpheader.bfSize = rowSize * height + sizeof(bmpheader) + sizeof(masks);
+    bmpheader.bfOffBits = sizeof(bmpheader) + sizeof(masks);
 
     bmpheader.biSize = 40;
     bmpheader.biWidth = width;
@@ -81,18 +396,15 @@ bool saveBMPtoSD_16bit(LGFX &lcd, const char *filename)
     bmpheader.biBitCount = 16;
     bmpheader.biCompression = 3;
 
-    file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
-    std::uint8_t buffer[rowSize];
-    memset(&buffer[rowSize - 4], 0, 4);
-    for (int y = lcd.height() - 1; y >= 0; y--)
-    {
-      lcd.readRect(0, y, lcd.width(), 1, (lgfx::rgb565_t*)buffer);
-      //printBuf565((lgfx::rgb565_t*)buffer, sizeof(buffer));
-      rotate_rgb565((lgfx::rgb565_t*)buffer, sizeof(buffer));
-      file.write(buffer, rowSize);
-    }
+    uint32_t ms = millis();
+    int rows;
+    SectorWriter out(file);
+    out.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
+    out.write((const std::uint8_t*)masks, sizeof(masks));
+    result = writeBands<lgfx::rgb565_t, Swizzle565>(lcd, out, rows);
+    result = out.flush() && result;
+    log_i("==> %s saved in %u ms, %d rows per band", filename, (unsigned)(millis() - ms), rows);
     file.close();
-    result = true;
   }
   else
   {
@@ -123,19 +435,8 @@ void printBuf888(lgfx::rgb888_t* buf, int bufSize)
  */
 void rotate_rgb888(lgfx::rgb888_t* buf, int bufSize)
 {
-  auto  rotateTriple = [](lgfx::rgb888_t* pRGB) 
-        {  
-          lgfx::rgb888_t tmp = *pRGB;
-          pRGB->r = tmp.g;
-          pRGB->g = tmp.b;
-          pRGB->b = tmp.r;
-        };
-  int nTriples = bufSize / 3;
-  for (int i = 0; i < nTriples; i++)
-  {
-    rotateTriple(buf);
-    buf++;
-  }  
+  uint8_t *p = (uint8_t *)buf;
+  swizzleRows<Swizzle888>(p, p, bufSize - bufSize % 3);
 }
 
 /**
@@ -155,6 +456,7 @@ bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename)
     int rowSize = (3 * width + 3) & ~ 3;
 
     lgfx::bitmap_header_t bmpheader;
+    memset(&bmpheader, 0, sizeof(bmpheader));
     bmpheader.bfType = 0x4D42;
     bmpheader.bfSize = rowSize * height + sizeof(bmpheader);
     bmpheader.bfOffBits = sizeof(bmpheader);
@@ -166,24 +468,229 @@ bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename)
     bmpheader.biBitCount = 24;
     bmpheader.biCompression = 0;
 
-    file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
-    std::uint8_t buffer[rowSize];
-    memset(&buffer[rowSize - 4], 0, 4);
-    //lcd.fillScreen(TFT_BLUE);
-    for (int y = lcd.height() - 1; y >= 0; y--)
+    uint32_t ms = millis();
+    int rows;
+    SectorWriter out(file);
+    out.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
+    result = writeBands<lgfx::rgb888_t, Swizzle888>(lcd, out, rows);
+    result = out.flush() && result;
+    log_i("==> %s saved in %u ms, %d rows per band", filename, (unsigned)(millis() - ms), rows);
+    file.close();
+  }
+  else
+  {
+    Serial.print("error:file open failure\n");
+  }
+  log_i("==> done");
+  return result;
+}
+
+/**
+ * Palette of at most 256 colors with a hash table to find 
+ * the index of a color. A color is 0x00RRGGBB, the layout of
+ * an RGBQUAD in the file.
+ */
+#define PALETTE_SLOTS 512   // power of 2, load at most 1/2
+
+class Palette
+{
+  public:
+    void clear()
     {
-      lcd.readRect(0, y, lcd.width(), 1, (lgfx::rgb888_t*)buffer);
-      //printBuf888((lgfx::rgb888_t*)buffer, sizeof(buffer));
-      rotate_rgb888((lgfx::rgb888_t*)buffer, sizeof(buffer));
-      file.write(buffer, rowSize);
+      memset(_key, 0, sizeof(_key));
+      memset(_rgbq, 0, sizeof(_rgbq));
+      _count = 0;
+    }
+
+    // Returns the index of the color, adds a new color, -1 if the palette is full
+    int indexOf(uint32_t color)
+    {
+      uint32_t key = color | 0x01000000;  // 0 marks a free slot
+      int h = (color * 2654435761u) >> 23;  // top 9 bits
+      while (_key[h])
+      {
+        if (_key[h] == key) return _index[h];
+        h = (h + 1) & (PALETTE_SLOTS - 1);
+      }
+      if (_count == 256) return -1;
+      _key[h]   = key;
+      _index[h] = _count;
+      _rgbq[_count] = color;
+      return _count++;
+    }
+
+    int count() const { return _count; }
+    const uint32_t *rgbq() const { return _rgbq; }
+
+  private:
+    uint32_t _key[PALETTE_SLOTS];
+    uint8_t  _index[PALETTE_SLOTS];
+    uint32_t _rgbq[256];
+    int      _count = 0;
+};
+
+
+/**
+ * Encodes a row of palette indices with BI_RLE8 into out and returns the
+ * number of bytes, at most 2 * width, without the end of line. Runs of 
+ * 2 or more pixels are encoded, the pixels in between are written in 
+ * absolute mode if there are at least 3 of them.
+ */
+static int encodeRowRLE8(const uint8_t *idx, int width, uint8_t *out)
+{
+  uint8_t *p = out;
+  int i = 0;
+  while (i < width)
+  {
+    int run = 1;
+    while (i + run < width && run < 255 && idx[i + run] == idx[i]) run++;
+    if (run >= 2)
+    {
+      *p++ = run;
+      *p++ = idx[i];
+      i += run;
+      continue;
+    }
+    int j = i + 1;
+    while (j < width && j - i < 255 && ! (j + 2 < width && idx[j] == idx[j + 1] && idx[j] == idx[j + 2])) j++;
+    int n = j - i;
+    if (n < 3)
+    { // absolute mode needs 3 or more pixels
+      for (; i < j; i++) { *p++ = 1; *p++ = idx[i]; }
+      continue;
+    }
+    *p++ = 0;
+    *p++ = n;
+    memcpy(p, idx + i, n);
+    p += n;
+    if (n & 1) *p++ = 0;  // absolute runs end on a word boundary
+    i = j;
+  }
+  return p - out;
+}
+
+
+/**
+ * Encodes the screen band by band from the bottom up. Returns 1 if 
+ * the screen was encoded, 0 on a failure and -1 if the screen has 
+ * more than 256 colors.
+ */
+static int writeBandsRLE8(LGFX &lcd, SectorWriter &out, Palette &palette, uint32_t &dataSize)
+{
+  int width    = lcd.width();
+  int height   = lcd.height();
+  int lineSize = 3 * width;
+  uint8_t *band = nullptr;
+  int rows = allocBand(band, lineSize, height, SCREENSHOT_MAX_BAND_BYTES / 2);
+  uint8_t *work = (uint8_t *)heap_caps_malloc(3 * width + 2, MALLOC_CAP_8BIT);  // indices and code of a row
+  int result = rows > 0 && work ? 1 : 0;
+  uint8_t *idx  = work;
+  uint8_t *code = work + width;
+  uint32_t lastColor = 0xFFFFFFFF;
+  int lastIndex = 0;
+
+  dataSize = 0;
+  for (int yEnd = height; yEnd > 0 && result > 0; yEnd -= rows)
+  {
+    int n = std::min(rows, yEnd);
+    lcd.readRect(0, yEnd - n, width, n, (lgfx::rgb888_t *)band);
+    for (int r = n - 1; r >= 0 && result > 0; r--)
+    {
+      uint8_t *line = band + r * lineSize;
+      swizzleRows<Swizzle888>(line, line, lineSize);
+      for (int x = 0; x < width; x++)
+      {
+        const uint8_t *px = line + 3 * x;
+        uint32_t color = px[0] | (px[1] << 8) | (px[2] << 16);
+        if (color != lastColor)
+        {
+          lastIndex = palette.indexOf(color);
+          lastColor = color;
+          if (lastIndex < 0) { result = -1; break; }
+        }
+        idx[x] = lastIndex;
+      }
+      if (result < 0) break;
+      int len = encodeRowRLE8(idx, width, code);
+      bool last = yEnd - n + r == 0;
+      code[len++] = 0;
+      code[len++] = last ? 1 : 0;  // end of bitmap or end of line
+      if (! out.write(code, len)) result = 0;
+      dataSize += len;
+    }
+  }
+  if (band) heap_caps_free(band);
+  if (work) heap_caps_free(work);
+  return result;
+}
+
+
+/**
+ * Saves the LCD screen to SD card as 8-bit BMP with palette and
+ * BI_RLE8 compression. Screens with flat colors like grids and text
+ * shrink to a few kB. The screen is encoded on the fly in bands, the 
+ * palette is collected while encoding and written at the end into the 
+ * space reserved for it after the header. If the screen has more than 
+ * 256 colors the file is saved with saveBMPtoSD_24bit() instead.
+ */
+bool saveBMPtoSD_rle8(LGFX &lcd, const char *filename)
+{
+  bool result = false;
+  File file = SD.open(filename, "w");
+  if (file)
+  {
+    Palette *palette = (Palette *)heap_caps_malloc(sizeof(Palette), MALLOC_CAP_8BIT);
+    if (! palette)
+    {
+      file.close();
+      log_e("==> no memory for the palette");
+      return false;
+    }
+    palette->clear();
+
+    lgfx::bitmap_header_t bmpheader;
+    const size_t paletteSize = 256 * 4;
+    memset(&bmpheader, 0, sizeof(bmpheader));
+
+    uint32_t ms = millis();
+    uint32_t dataSize;
+    SectorWriter out(file);
+    out.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
+    out.write((const std::uint8_t*)palette->rgbq(), paletteSize);  // still empty, reserves the space
+    int encoded = writeBandsRLE8(lcd, out, *palette, dataSize);
+    result = out.flush() && encoded > 0;
+    if (result)
+    {
+      bmpheader.bfType = 0x4D42;
+      bmpheader.bfSize = sizeof(bmpheader) + paletteSize + dataSize;
+      bmpheader.bfOffBits = sizeof(bmpheader) + paletteSize;
+
+      bmpheader.biSize = 40;
+      bmpheader.biWidth = lcd.width();
+      bmpheader.biHeight = lcd.height();
+      bmpheader.biPlanes = 1;
+      bmpheader.biBitCount = 8;
+      bmpheader.biCompression = 1;
+      bmpheader.biSizeImage = dataSize;
+      bmpheader.biClrUsed = palette->count();
+
+      result = file.seek(0) 
+            && file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader)) == sizeof(bmpheader)
+            && file.write((const std::uint8_t*)palette->rgbq(), 4 * palette->count()) == 4 * (size_t)palette->count();
+      log_i("==> %s saved in %u ms, %u bytes, %d colors", filename, (unsigned)(millis() - ms), 
+            (unsigned)bmpheader.bfSize, palette->count());
     }
     file.close();
-    result = true;
+    heap_caps_free(palette);
+    if (encoded < 0)
+    {
+      log_i("==> more than 256 colors, saving 24 bit");
+      return saveBMPtoSD_24bit(lcd, filename);
+    }
   }
   else
   {
     Serial.print("error:file open failure\n");
   }
-  log_i("==> done");
   return result;
-}
\ No newline at end of file
+}
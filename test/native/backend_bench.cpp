@@ -0,0 +1,64 @@
+/**
+ * File         backend_bench.cpp
+ *
+ * Purpose      Samples per second and CPU time per sample of getTouch()
+ *              over the bit-bang, hardware SPI and mock backends, reported
+ *              by XPT2046_Bitbang::benchmarkTransport() and by the CPU time
+ *              of the thread. The simulated SPI blocks for the time of the 
+ *              bits on the bus like the polling driver of the ESP32 core.
+ */
+
+#include <time.h>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+#define NBR_SAMPLES 500
+
+static LGFX lcd;
+
+static uint64_t cpuNanos()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+int main()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    SPIClass spi(VSPI);
+    XPT2046_BitbangTransport bitbang(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    XPT2046_SpiTransport hwspi(spi, TP_SCLK, TP_MISO, TP_MOSI, TP_CS);
+    SimTransport mock(sim);
+    XPT2046_Transport *bus[] = {&bitbang, &hwspi, &mock};
+    double usCpu[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (bus[i] == &hwspi) sim.attachSpi(VSPI);
+        else sim.attachPins();
+        XPT2046_Bitbang touchpad(lcd, *bus[i]);
+        touchpad.begin();
+        touchpad.setClockFrequency(XPT2046_MAX_CLOCK_HZ);
+        sim.touch(646, 1034);
+
+        TouchPoint tp;
+        CHECK(touchpad.getTouch(tp));
+        CHECK_NEAR(tp.x, 40, 1);
+        CHECK_NEAR(tp.y, 40, 1);
+        touchpad.benchmarkTransport(NBR_SAMPLES);
+
+        uint64_t ns = cpuNanos();
+        for (int n = 0; n < NBR_SAMPLES; n++) touchpad.getTouch(tp);
+        usCpu[i] = (cpuNanos() - ns) / 1000.0 / NBR_SAMPLES;
+        printf("          %-8s %6.1f us CPU time/sample\n", bus[i]->name(), usCpu[i]);
+        sim.detach();
+    }
+    // the polling SPI driver keeps the CPU busy for the bits on the bus like
+    // the bit-bang engine, the mock shows the cost of the logic alone
+    CHECK(usCpu[1] < 1.2 * usCpu[0]);
+    CHECK(usCpu[2] * 10 < usCpu[1]);
+    return testResult("backend_bench");
+}
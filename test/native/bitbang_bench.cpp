@@ -0,0 +1,104 @@
+/**
+ * File         bitbang_bench.cpp
+ *
+ * Purpose      Time of a touch sample (Z1, Z2, X, Y) with the former 
+ *              bit-bang engine, digitalWrite() / digitalRead() and two 
+ *              delayMicroseconds(5) per clock, against XPT2046_BitbangTransport.
+ *              The new engine must be at least 10 times faster at its 
+ *              maximum clock rate. Runs in real time against the simulated
+ *              controller, so the protocol is checked on the way.
+ */
+
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+#define DELAY 5
+#define NBR_SAMPLES 200
+
+/**
+ * The engine of XPT2046_Bitbang before the transport interface
+ */
+namespace legacy
+{
+    void writeSPI(byte command)
+    {
+        for (int i = 7; i >= 0; i--)
+        {
+            digitalWrite(TP_MOSI, command & (1 << i));
+            digitalWrite(TP_SCLK, LOW);
+            delayMicroseconds(DELAY);
+            digitalWrite(TP_SCLK, HIGH);
+            delayMicroseconds(DELAY);
+        }
+        digitalWrite(TP_MOSI, LOW);
+        digitalWrite(TP_SCLK, LOW);
+    }
+
+    uint16_t readSPI(byte command)
+    {
+        writeSPI(command);
+        uint16_t result = 0;
+        for (int i = 15; i >= 0; i--)
+        {
+            digitalWrite(TP_SCLK, HIGH);
+            delayMicroseconds(DELAY);
+            digitalWrite(TP_SCLK, LOW);
+            delayMicroseconds(DELAY);
+            result |= (digitalRead(TP_MISO) << i);
+        }
+        return result >> 4;
+    }
+
+    void sample(TouchPoint &tp)
+    {
+        digitalWrite(TP_CS, LOW);
+        tp.zValue = readSPI(CMD_READ_Z1) + 4095 - readSPI(CMD_READ_Z2);
+        tp.xValue = readSPI(CMD_READ_X);
+        tp.yValue = readSPI(CMD_READ_Y & ~((byte)1));
+        digitalWrite(TP_CS, HIGH);
+    }
+}
+
+
+static void sample(XPT2046_Transport &bus, TouchPoint &tp)
+{
+    bus.select();
+    tp.zValue = bus.transfer(CMD_READ_Z1) + 4095 - bus.transfer(CMD_READ_Z2);
+    tp.xValue = bus.transfer(CMD_READ_X);
+    tp.yValue = bus.transfer(CMD_READ_Y & ~((byte)1));
+    bus.deselect();
+}
+
+
+int main()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_BitbangTransport bus(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    bus.begin();
+    sim.touch(1500, 2500);
+    TouchPoint tp = {};
+
+    uint64_t ns = wallNanos();
+    for (int i = 0; i < NBR_SAMPLES; i++) legacy::sample(tp);
+    double usLegacy = (wallNanos() - ns) / 1000.0 / NBR_SAMPLES;
+    CHECK_EQ(tp.xValue, 1500);
+    CHECK_EQ(tp.yValue, 2500);
+    printf("legacy         %8.1f us/sample\n", usLegacy);
+
+    double usFast = 0;
+    for (uint32_t hz : {1000000UL, XPT2046_MAX_CLOCK_HZ})
+    {
+        bus.setClockFrequency(hz);
+        tp = TouchPoint {};
+        ns = wallNanos();
+        for (int i = 0; i < NBR_SAMPLES; i++) sample(bus, tp);
+        usFast = (wallNanos() - ns) / 1000.0 / NBR_SAMPLES;
+        CHECK_EQ(tp.xValue, 1500);
+        CHECK_EQ(tp.yValue, 2500);
+        printf("bitbang %4u kHz %7.1f us/sample  %5.1fx\n", (unsigned)(hz / 1000), usFast, usLegacy / usFast);
+    }
+    CHECK(usLegacy / usFast >= 10.0);
+    return testResult("bitbang_bench");
+}
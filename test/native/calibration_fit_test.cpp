@@ -0,0 +1,175 @@
+/**
+ * File         calibration_fit_test.cpp
+ *
+ * Purpose      Fit of the affine calibration (XPT2046_Calibration.h) to
+ *              synthetic calibration points of a touch layer that is rotated,
+ *              skewed and scaled differently on both axes relative to the
+ *              display, with noise on the raw values. Reports the residual of
+ *              the fit, the error over the whole screen and the cost of the
+ *              transform per sample compared with the two map() calls of the
+ *              former 2 point calibration.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "check.h"
+#include "XPT2046_Calibration.h"
+
+#define WIDTH   320
+#define HEIGHT  240
+#define NBR_SAMPLES 100000
+
+/**
+ * The touch layer: raw = M * screen + offset, rotated by 1.5 degrees,
+ * skewed by 1 degree, 11.5 and 15.0 raw units per pixel
+ */
+static void toRaw(double x, double y, double &xValue, double &yValue)
+{
+    const double rot = 1.5 * M_PI / 180, skew = 1.0 * M_PI / 180;
+    double u =  cos(rot) * x + sin(rot + skew) * y;
+    double v = -sin(rot) * x + cos(rot + skew) * y;
+    xValue = 11.5 * u + 280;
+    yValue = 15.0 * v + 330;
+}
+
+
+static double noise(double amp)
+{
+    return amp * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+
+static TouchCalibration makeCalibration(const int (*targets)[2], int n, double amp)
+{
+    TouchCalibration cal = {};
+    cal.nbrPoints = n;
+    for (int i = 0; i < n; i++)
+    {
+        double xv, yv;
+        toRaw(targets[i][0], targets[i][1], xv, yv);
+        cal.point[i].x = targets[i][0];
+        cal.point[i].y = targets[i][1];
+        cal.point[i].xValue = (int)lround(xv + noise(amp));
+        cal.point[i].yValue = (int)lround(yv + noise(amp));
+    }
+    return cal;
+}
+
+
+/**
+ * Largest distance in pixels between the transformed raw values
+ * and the true position on a grid over the screen
+ */
+static double maxScreenError(const AffineTransform &t)
+{
+    double maxErr = 0;
+    for (int y = 0; y < HEIGHT; y += 8)
+        for (int x = 0; x < WIDTH; x += 8)
+        {
+            double xv, yv;
+            int sx, sy;
+            toRaw(x, y, xv, yv);
+            applyAffineTransform(t, (int)lround(xv), (int)lround(yv), sx, sy);
+            maxErr = fmax(maxErr, hypot(sx - x, sy - y));
+        }
+    return maxErr;
+}
+
+
+static long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+
+int main()
+{
+    static const int points2[][2] = { {20, 20}, {300, 220} };
+    static const int points3[][2] = { {20, 20}, {300, 120}, {60, 220} };
+    static const int points5[][2] = { {20, 20}, {300, 20}, {160, 120}, {20, 220}, {300, 220} };
+    static const int points9[][2] = { {20, 20}, {160, 20}, {300, 20}, {20, 120}, {160, 120},
+                                      {300, 120}, {20, 220}, {160, 220}, {300, 220} };
+    struct { const char *name; const int (*targets)[2]; int n; } sets[] = {
+        { "2 points", points2, 2 }, { "3 points", points3, 3 },
+        { "5 points", points5, 5 }, { "9 points", points9, 9 } };
+    double err[4];
+
+    srand(1947);
+    for (int s = 0; s < 4; s++)
+    {
+        AffineTransform t;
+        float rms = -1;
+        double rmsNoisy = 0, errNoisy = 0;
+
+        // exact raw values: the fit must reproduce the layer
+        TouchCalibration cal = makeCalibration(sets[s].targets, sets[s].n, 0);
+        CHECK(fitAffineTransform(cal, t, &rms));
+        err[s] = maxScreenError(t);
+
+        // noise of +-8 raw units (about 0.5 pixel), mean over 50 fits
+        for (int k = 0; k < 50; k++)
+        {
+            AffineTransform tn;
+            float r;
+            cal = makeCalibration(sets[s].targets, sets[s].n, 8);
+            CHECK(fitAffineTransform(cal, tn, &r));
+            rmsNoisy += r / 50;
+            errNoisy += maxScreenError(tn) / 50;
+        }
+        printf("%-9s residual %5.2f px, max error %5.2f px, with noise: residual %5.2f px, max error %5.2f px\n",
+               sets[s].name, rms, err[s], rmsNoisy, errNoisy);
+        if (s > 0) CHECK(errNoisy < 3);
+    }
+    CHECK(err[0] > 4);        // 2 points cannot correct the rotation
+    CHECK(err[1] < 1.5);
+    CHECK(err[2] < 1.5);
+    CHECK(err[3] < 1.5);
+
+    // points on a line fall back to the 2 point calibration
+    static const int line[][2] = { {20, 20}, {160, 120}, {300, 220} };
+    AffineTransform t;
+    CHECK(fitAffineTransform(makeCalibration(line, 3, 0), t));
+    CHECK(t.b == 0 && t.d == 0);
+
+    // the folded rotation gives the rotated screen coordinates
+    TouchCalibration cal = makeCalibration(points5, 5, 0);
+    CHECK(fitAffineTransform(cal, t));
+    for (uint8_t r = 0; r < 4; r++)
+    {
+        AffineTransform tr = rotateAffineTransform(t, r, WIDTH, HEIGHT);
+        int x, y, xr, yr;
+        applyAffineTransform(t,  cal.point[0].xValue, cal.point[0].yValue, x, y);
+        applyAffineTransform(tr, cal.point[0].xValue, cal.point[0].yValue, xr, yr);
+        int xe[4] = { x, y,         WIDTH - x,  HEIGHT - y };
+        int ye[4] = { y, WIDTH - x, HEIGHT - y, x };
+        CHECK_NEAR(xr, xe[r], 1);
+        CHECK_NEAR(yr, ye[r], 1);
+    }
+
+    // cost per sample
+    std::vector<int> raw(2 * 1024);
+    for (size_t i = 0; i < raw.size(); i++) raw[i] = 200 + rand() % 3700;
+    int sx = 0, sy = 0;
+    uint64_t ns = wallNanos();
+    for (int i = 0; i < NBR_SAMPLES; i++)
+    {
+        const int *p = &raw[2 * (i & 1023)];
+        applyAffineTransform(t, p[0], p[1], sx, sy);
+        keep(sx); keep(sy);
+    }
+    double nsAffine = (double)(wallNanos() - ns) / NBR_SAMPLES;
+    ns = wallNanos();
+    for (int i = 0; i < NBR_SAMPLES; i++)
+    {
+        const int *p = &raw[2 * (i & 1023)];
+        sx = map(p[0], 510, 3730, 20, 300);
+        sy = map(p[1], 630, 3580, 20, 220);
+        keep(sx); keep(sy);
+    }
+    double nsMap = (double)(wallNanos() - ns) / NBR_SAMPLES;
+    printf("transform %.1f ns/sample, former map() %.1f ns/sample\n", nsAffine, nsMap);
+    CHECK(nsAffine < 200);
+
+    return testResult("calibration_fit_test");
+}
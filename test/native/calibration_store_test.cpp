@@ -0,0 +1,252 @@
+/**
+ * File         calibration_store_test.cpp
+ *
+ * Purpose      Calibration blob (packCalibration() / unpackCalibration())
+ *              and its storage by XPT2046_Bitbang in the Preferences stand-in:
+ *              saving, loading by a new driver as after a restart, a blob of
+ *              a later version with appended fields, a corrupted blob and
+ *              the conversion of the former format with one key per value.
+ */
+
+#include <vector>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+
+static const TouchCalibration cal3 = {3, {{ 20,  20,  510,  630, 0, 0},
+                                          {300, 120, 3730, 2100, 0, 0},
+                                          { 60, 220,  980, 3580, 0, 0}}};
+
+static void put32(uint8_t *p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = v >> (8 * i); }
+
+
+/**
+ * Blob of a later version: the points followed by extra fields
+ */
+static std::vector<uint8_t> futureBlob(const TouchCalibration &cal, size_t extra)
+{
+    std::vector<uint8_t> blob(XPT2046_CAL_BLOB_MAX);
+    blob.resize(packCalibration(cal, blob.data(), blob.size()));
+    size_t payload = blob.size() - XPT2046_CAL_HEADER_SIZE - 4 + extra;
+    blob.resize(blob.size() - 4);
+    blob.insert(blob.end(), extra, 0x5A);
+    blob[2] = XPT2046_CAL_VERSION + 1;
+    blob[4] = payload; blob[5] = payload >> 8;
+    blob.resize(blob.size() + 4);
+    put32(&blob[blob.size() - 4], crc32(blob.data(), blob.size() - 4));
+    return blob;
+}
+
+
+static void storeBlob(const std::vector<uint8_t> &blob)
+{
+    Preferences prefs;
+    prefs.begin("CALDATA");
+    prefs.clear();
+    prefs.putBytes("CALBLOB", blob.data(), blob.size());
+    prefs.end();
+}
+
+
+static bool waitForKey(const char *key, bool present)
+{
+    Preferences prefs;
+    for (int ms = 0; ms < 1000; ms++, delay(1))
+    {
+        bool found = prefs.begin("CALDATA", true) && prefs.isKey(key);
+        prefs.end();
+        if (found == present) return true;
+    }
+    return false;
+}
+
+
+/**
+ * Maps the raw values of point p with the calibration of a new driver
+ */
+static bool touchAt(XPT2046Sim &sim, XPT2046_Bitbang &touchpad, const TouchPoint &p, TouchPoint &tp)
+{
+    sim.touch(p.xValue, p.yValue);
+    bool ok = touchpad.getTouch(tp);
+    sim.release();
+    return ok;
+}
+
+
+static void testBlob()
+{
+    uint8_t buf[XPT2046_CAL_BLOB_MAX];
+    TouchCalibration out = {};
+    size_t len = packCalibration(cal3, buf, sizeof(buf));
+    CHECK_EQ(len, XPT2046_CAL_HEADER_SIZE + 4 + 3 * 20 + 4);
+    CHECK(unpackCalibration(buf, len, out));
+    CHECK_EQ(out.nbrPoints, 3);
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQ(out.point[i].x, cal3.point[i].x);
+        CHECK_EQ(out.point[i].y, cal3.point[i].y);
+        CHECK_EQ(out.point[i].xValue, cal3.point[i].xValue);
+        CHECK_EQ(out.point[i].yValue, cal3.point[i].yValue);
+    }
+    CHECK_EQ(packCalibration(cal3, buf, len - 1), 0);
+    CHECK(! unpackCalibration(buf, len - 1, out));
+    for (size_t i = 0; i < len; i++)
+    {
+        buf[i] ^= 0x10;
+        CHECK(! unpackCalibration(buf, len, out));
+        buf[i] ^= 0x10;
+    }
+
+    std::vector<uint8_t> blob = futureBlob(cal3, 400);
+    out = TouchCalibration {};
+    CHECK(unpackCalibration(blob.data(), blob.size(), out));
+    CHECK_EQ(out.nbrPoints, 3);
+    CHECK_EQ(out.point[2].yValue, 3580);
+}
+
+
+/**
+ * A saved calibration is found by the next driver, read once
+ */
+static void testSaveAndLoad()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    TouchPoint tp;
+    host::eraseNvs();
+    {
+        XPT2046_Bitbang touchpad(lcd, bus);
+        touchpad.begin();
+        CHECK(! touchpad.isCalibrationDataAvailable());
+        CHECK(! touchpad.recallCalibrationData());
+        touchpad.saveCalibrationData();        // the default calibration
+        CHECK(touchpad.isCalibrationDataAvailable());
+        CHECK(waitForKey("CALBLOB", true));
+        delay(10);
+    }
+    Preferences prefs;
+    uint8_t buf[XPT2046_CAL_BLOB_MAX];
+    TouchCalibration out = {};
+    CHECK(prefs.begin("CALDATA", true));
+    size_t len = prefs.getBytes("CALBLOB", buf, sizeof(buf));
+    prefs.end();
+    CHECK(unpackCalibration(buf, len, out));
+    CHECK_EQ(out.nbrPoints, 2);
+    CHECK_EQ(out.point[1].xValue, 3365);
+
+    storeBlob(futureBlob(cal3, 0));
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    uint32_t reads = host::nvsReads();
+    CHECK(touchpad.recallCalibrationData());
+    CHECK(host::nvsReads() > reads);
+    reads = host::nvsReads();
+    CHECK(touchpad.isCalibrationDataAvailable());
+    CHECK(touchpad.recallCalibrationData());
+    CHECK_EQ(host::nvsReads(), reads);
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(touchAt(sim, touchpad, cal3.point[i], tp));
+        CHECK_NEAR(tp.x, cal3.point[i].x, 1);
+        CHECK_NEAR(tp.y, cal3.point[i].y, 1);
+    }
+}
+
+
+/**
+ * A blob of a later version larger than the former read buffer of
+ * 256 bytes is loaded, a corrupted one is ignored, as is one longer 
+ * than XPT2046_CAL_BLOB_READ_MAX
+ */
+static void testLargeAndCorruptBlob()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    TouchPoint tp;
+    std::vector<uint8_t> blob = futureBlob(cal3, 400);
+    CHECK(blob.size() > 256);
+    storeBlob(blob);
+    {
+        XPT2046_Bitbang touchpad(lcd, bus);
+        touchpad.begin();
+        CHECK(touchpad.recallCalibrationData());
+        CHECK(touchAt(sim, touchpad, cal3.point[1], tp));
+        CHECK_NEAR(tp.x, 300, 1);
+        CHECK_NEAR(tp.y, 120, 1);
+    }
+
+    blob[XPT2046_CAL_HEADER_SIZE + 12] ^= 1;
+    storeBlob(blob);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    CHECK(! touchpad.isCalibrationDataAvailable());
+    CHECK(! touchpad.recallCalibrationData());
+    CHECK(touchAt(sim, touchpad, TouchPoint {40, 40, 646, 1034, 0, 0}, tp));  // still the default
+    CHECK_NEAR(tp.x, 40, 1);
+    CHECK_NEAR(tp.y, 40, 1);
+
+    TouchCalibration out;
+    blob = futureBlob(cal3, XPT2046_CAL_BLOB_READ_MAX);
+    CHECK(unpackCalibration(blob.data(), blob.size(), out));      // valid, but too long to be read
+    storeBlob(blob);
+    XPT2046_Bitbang tooLong(lcd, bus);
+    tooLong.begin();
+    CHECK(! tooLong.isCalibrationDataAvailable());
+}
+
+
+/**
+ * The keys of the former format are converted to a blob
+ */
+static void testLegacyKeys()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    TouchPoint tp;
+    host::eraseNvs();
+    Preferences prefs;
+    prefs.begin("CALDATA");
+    prefs.putInt("INIT_FLAG", 1947);
+    prefs.putInt("xTouchMin", 20);
+    prefs.putInt("yTouchMin", 20);
+    prefs.putInt("xValueTouchMin", 510);
+    prefs.putInt("yValueTouchMin", 630);
+    prefs.putInt("xTouchMax", 300);
+    prefs.putInt("yTouchMax", 220);
+    prefs.putInt("xValueTouchMax", 3730);
+    prefs.putInt("yValueTouchMax", 3580);
+    prefs.end();
+
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    CHECK(touchpad.recallCalibrationData());
+    CHECK(touchAt(sim, touchpad, TouchPoint {300, 220, 3730, 3580, 0, 0}, tp));
+    CHECK_NEAR(tp.x, 300, 1);
+    CHECK_NEAR(tp.y, 220, 1);
+    CHECK(waitForKey("CALBLOB", true));
+    CHECK(waitForKey("INIT_FLAG", false));
+
+    uint8_t buf[XPT2046_CAL_BLOB_MAX];
+    TouchCalibration out = {};
+    prefs.begin("CALDATA", true);
+    size_t len = prefs.getBytes("CALBLOB", buf, sizeof(buf));
+    CHECK(! prefs.isKey("xValueTouchMax"));
+    prefs.end();
+    CHECK(unpackCalibration(buf, len, out));
+    CHECK_EQ(out.nbrPoints, 2);
+    CHECK_EQ(out.point[0].xValue, 510);
+    CHECK_EQ(out.point[1].yValue, 3580);
+    delay(10);
+}
+
+
+int main()
+{
+    testBlob();
+    testSaveAndLoad();
+    testLargeAndCorruptBlob();
+    testLegacyKeys();
+    return testResult("calibration_store_test");
+}
@@ -0,0 +1,131 @@
+/**
+ * File         calibration_trace_test.cpp
+ *
+ * Purpose      CalibrationStateMachine fed from a recorded trace. The driver
+ *              samples the simulated controller while a script touches three
+ *              targets, sliding onto each and with noise and spikes, and
+ *              records the trace. TraceReader reads it back into the state
+ *              machine, which must find the raw values of the targets. The
+ *              same trace replayed into a calibration of the driver gives
+ *              the same result.
+ */
+
+#include <vector>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+#define NBR_POINTS 3
+
+static LGFX lcd;
+
+static const TouchPoint targets[NBR_POINTS] = {{ 20,  20,  510,  630, 0, 0},
+                                               {300, 120, 3730, 2100, 0, 0},
+                                               { 60, 220,  980, 3580, 0, 0}};
+
+
+/**
+ * The pen slides onto each target within 30 ms, rests for 400 ms
+ * and is lifted for 400 ms
+ */
+static std::vector<XPT2046Sim::Keyframe> script()
+{
+    std::vector<XPT2046Sim::Keyframe> s;
+    uint32_t ms = 100;
+    for (const TouchPoint &t : targets)
+    {
+        s.push_back({ms,       true,  t.xValue - 150, t.yValue + 120, 900});
+        s.push_back({ms + 30,  true,  t.xValue,       t.yValue,       400});
+        s.push_back({ms + 430, true,  t.xValue,       t.yValue,       400});
+        s.push_back({ms + 431, false, 0,              0,              0});
+        ms += 830;
+    }
+    return s;
+}
+
+
+static std::vector<uint8_t> recordTrace()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    host::MemoryStream trace;
+    touchpad.begin();
+    sim.setNoise(6, 4);
+    sim.setSpikes(10, 250);
+    touchpad.startTrace(trace);
+    sim.play(script());
+    TouchPoint tp;
+    while (sim.isPlaying())
+    {
+        touchpad.getTouch(tp);
+        delay(10);
+    }
+    touchpad.getTouch(tp);
+    touchpad.stopTrace();
+    return trace.data();
+}
+
+
+int main()
+{
+    host::useVirtualTime();
+    std::vector<uint8_t> trace = recordTrace();
+
+    TraceReader reader;
+    TraceRecord r;
+    CalibrationStateMachine sm;
+    int records = 0, penUps = 0, finished = 0;
+    CHECK(reader.begin(trace.data(), trace.size()));
+    sm.start(targets, NBR_POINTS, 5);
+    while (reader.next(r))
+    {
+        records++;
+        if (! r.penDown) penUps++;
+        if (sm.feed(r.penDown, r.xValue, r.yValue, r.ms) == CalibrationStateMachine::EV_FINISHED) finished++;
+    }
+    // no record follows the last pen up, the next sample ends the pen up time
+    CHECK_EQ(finished, 0);
+    if (sm.feed(false, 0, 0, r.ms + XPT2046_CAL_PEN_UP_MS) == CalibrationStateMachine::EV_FINISHED) finished++;
+    printf("%d records, %d pen up\n", records, penUps);
+    CHECK(records > 3 * 35);
+    CHECK_EQ(penUps, NBR_POINTS);
+    CHECK_EQ(finished, 1);
+    CHECK_EQ(sm.state(), CalibrationStateMachine::DONE);
+
+    const TouchCalibration &cal = sm.result();
+    CHECK_EQ(cal.nbrPoints, NBR_POINTS);
+    for (int i = 0; i < NBR_POINTS; i++)
+    {
+        printf("point %d  raw %4d %4d  error %3d %3d  confidence %d%%\n", i, cal.point[i].xValue, cal.point[i].yValue,
+               cal.point[i].xValue - targets[i].xValue, cal.point[i].yValue - targets[i].yValue, sm.confidence(i));
+        CHECK_NEAR(cal.point[i].xValue, targets[i].xValue, 8);
+        CHECK_NEAR(cal.point[i].yValue, targets[i].yValue, 8);
+        CHECK(sm.confidence(i) >= XPT2046_CAL_MIN_CONFIDENCE);
+    }
+
+    // the driver replays the trace into its calibration
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    host::MemoryStream in(trace);
+    touchpad.begin();
+    TouchPoint t[NBR_POINTS];
+    for (int i = 0; i < NBR_POINTS; i++) t[i] = targets[i];
+    touchpad.startCalibration(t, NBR_POINTS, 5);
+    CHECK_EQ(touchpad.replayTrace(in), (size_t)records);
+    for (int i = 0; i < 10 && touchpad.calibrationTick(); i++) delay(10);
+    CHECK(! touchpad.isCalibrating());
+    printf("residual of the fit %.2f px\n", touchpad.getCalibrationResidual());
+    CHECK(touchpad.getCalibrationResidual() < 1.0f);
+    for (int i = 0; i < NBR_POINTS; i++)
+    {
+        TouchPoint tp;
+        sim.touch(cal.point[i].xValue, cal.point[i].yValue);
+        CHECK(touchpad.getTouch(tp));
+        CHECK_NEAR(tp.x, targets[i].x, 1);
+        CHECK_NEAR(tp.y, targets[i].y, 1);
+    }
+    delay(100);   // the calibration is saved in the background
+    return testResult("calibration_trace_test");
+}
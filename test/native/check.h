@@ -0,0 +1,51 @@
+/**
+ * Header       check.h
+ *
+ * Purpose      Checks and timing for the host tests and benchmarks.
+ *              A failed CHECK() is reported with file and line, the 
+ *              program goes on and returns 1 at the end (testResult()).
+ */
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+    do { if (! (cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); g_failures++; } } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { long long va = (long long)(a), vb = (long long)(b); \
+         if (va != vb) { fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                                 __FILE__, __LINE__, #a, #b, va, vb); g_failures++; } } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+    do { double va = (double)(a), vb = (double)(b); \
+         if (va - vb > (tol) || vb - va > (tol)) { fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s) failed: %g != %g\n", \
+                                 __FILE__, __LINE__, #a, #b, va, vb); g_failures++; } } while (0)
+
+inline int testResult(const char *name)
+{
+    printf("%s: %s\n", name, g_failures ? "FAILED" : "passed");
+    return g_failures ? 1 : 0;
+}
+
+/**
+ * Wall clock in ns for the benchmarks
+ */
+inline uint64_t wallNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Defeats the optimizer in benchmark loops
+ */
+template <typename T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
@@ -0,0 +1,103 @@
+/**
+ * File         dispatch_bench.cpp
+ *
+ * Purpose      Latency of TouchDispatcher::dispatch() (XPT2046_Dispatch.h)
+ *              with 1, 8 and 32 subscribers of an event type, each with its
+ *              own context, compared with the single function pointer per
+ *              event of the former driver. Handlers keep the order of
+ *              subscription when others are removed or replaced.
+ */
+
+#include <vector>
+#include "check.h"
+#include "XPT2046_Dispatch.h"
+
+#define NBR_EVENTS 1000000
+
+using Widget = struct wdgt { int taps; int sum; };
+
+static void onTap(void *ctx, const TouchEvent &ev)
+{
+    Widget *w = static_cast<Widget *>(ctx);
+    w->taps++;
+    w->sum += ev.x;
+}
+
+// the former callback, the widget had to be a global
+static Widget global;
+static void onShortTouch(int x, int y) { (void)y; global.taps++; global.sum += x; }
+
+
+static std::vector<char> calls;
+static void onCall(void *ctx, const TouchEvent &ev) { (void)ev; calls.push_back(*static_cast<const char *>(ctx)); }
+
+
+/**
+ * A, B, C subscribed, A removed: B runs before C
+ */
+static void testOrder()
+{
+    static const char a = 'A', b = 'B', c = 'C', d = 'D';
+    TouchDispatcher disp;
+    TouchEvent ev = {TOUCH_SHORT, 0, 0, 0, 0, 0, 0, 0, 0};
+    CHECK(disp.subscribe(TOUCH_SHORT, onCall, (void *)&a));
+    CHECK(disp.subscribe(TOUCH_SHORT, onCall, (void *)&b));
+    CHECK(disp.subscribe(TOUCH_SHORT, onCall, (void *)&c));
+    CHECK(disp.unsubscribe(TOUCH_SHORT, onCall, (void *)&a));
+    CHECK(! disp.unsubscribe(TOUCH_SHORT, onCall, (void *)&a));
+    CHECK(disp.subscribe(TOUCH_SHORT, onCall, (void *)&d));
+    disp.dispatch(ev);
+    CHECK(calls == std::vector<char>({'B', 'C', 'D'}));
+    calls.clear();
+    CHECK(disp.unsubscribe(TOUCH_SHORT, onCall, (void *)&c));
+    disp.dispatch(ev);
+    CHECK(calls == std::vector<char>({'B', 'D'}));
+}
+
+
+int main()
+{
+    testOrder();
+    static_assert(XPT2046_MAX_SUBSCRIBERS >= 32, "build with -D XPT2046_MAX_SUBSCRIBERS=32");
+    TouchEvent ev = {TOUCH_SHORT, 100, 50, 0, 0, 0, 0, 0, 0};
+
+    void (*volatile legacyCb)(int, int) = onShortTouch;
+    uint64_t ns = wallNanos();
+    for (int i = 0; i < NBR_EVENTS; i++)
+    {
+        ev.x = i & 255;
+        if (legacyCb) legacyCb(ev.x, ev.y);
+    }
+    double nsLegacy = (double)(wallNanos() - ns) / NBR_EVENTS;
+    printf("former callback          %6.2f ns/event\n", nsLegacy);
+
+    double nsPerHandler[3];
+    int counts[] = {1, 8, 32};
+    for (int k = 0; k < 3; k++)
+    {
+        int n = counts[k];
+        TouchDispatcher d;
+        std::vector<Widget> widgets(n, Widget {0, 0});
+        for (Widget &w : widgets) CHECK(d.subscribe(TOUCH_SHORT, onTap, &w));
+        CHECK_EQ(d.subscribers(TOUCH_SHORT), n);
+        CHECK_EQ(d.subscribers(TOUCH_LONG), 0);
+
+        ns = wallNanos();
+        for (int i = 0; i < NBR_EVENTS; i++)
+        {
+            ev.x = i & 255;
+            d.dispatch(ev);
+        }
+        double nsEvent = (double)(wallNanos() - ns) / NBR_EVENTS;
+        nsPerHandler[k] = nsEvent / n;
+        keep(widgets);
+        for (const Widget &w : widgets) CHECK_EQ(w.taps, NBR_EVENTS);
+        CHECK_EQ(widgets[n - 1].sum, widgets[0].sum);
+        printf("%2d subscriber%s           %6.2f ns/event  %5.2f ns/handler\n", n, n > 1 ? "s" : " ", nsEvent, nsPerHandler[k]);
+    }
+
+    // the cost grows with the number of handlers, not more
+    CHECK(nsPerHandler[2] < 2 * nsPerHandler[1] + 1);
+    CHECK(nsPerHandler[0] < 2 * nsLegacy + 2);
+    return testResult("dispatch_bench");
+}
@@ -0,0 +1,180 @@
+/**
+ * File         driver_sim_test.cpp
+ *
+ * Purpose      XPT2046_Bitbang talking to the simulated controller over
+ *              the bit-bang pins, hardware SPI and the mock backend
+ */
+
+#include <string>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+
+
+/**
+ * The raw values reach the driver unchanged over every backend
+ */
+static void testTransports()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    SPIClass spi(VSPI);
+    XPT2046_BitbangTransport bitbang(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    XPT2046_SpiTransport hwspi(spi, TP_SCLK, TP_MISO, TP_MOSI, TP_CS);
+    SimTransport mock(sim);
+    XPT2046_Transport *bus[] = {&bitbang, &hwspi, &mock};
+
+    for (XPT2046_Transport *b : bus)
+    {
+        if (b == &hwspi) sim.attachSpi(VSPI);
+        else sim.attachPins();
+        b->begin();
+        sim.touch(2345, 1234, 500);
+        b->select();
+        CHECK_EQ(b->transfer(CMD_READ_X), 2345);
+        CHECK_EQ(b->transfer(CMD_READ_Y), 1234);
+        int z1 = b->transfer(CMD_READ_Z1);
+        int z2 = b->transfer(CMD_READ_Z2);
+        b->deselect();
+        PressureDetector p;
+        CHECK_NEAR(p.resistance(2345, z1, z2), 500, 10);
+        sim.release();
+        b->select();
+        CHECK(b->transfer(CMD_READ_Z1) < XPT2046_Z1_MARGIN);
+        CHECK_EQ(b->transfer(CMD_READ_Z2), 4095);
+        b->deselect();
+        sim.detach();
+    }
+}
+
+
+/**
+ * PENIRQ follows the pen and the power down bits of the last command
+ */
+static void testPenIrq()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_BitbangTransport bus(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    bus.begin();
+    CHECK_EQ(digitalRead(TP_IRQ), HIGH);
+    sim.touch(1000, 1000);
+    CHECK_EQ(digitalRead(TP_IRQ), LOW);
+    bus.select();
+    bus.transfer(CMD_READ_X);
+    CHECK_EQ(digitalRead(TP_IRQ), HIGH);     // PD = 01, PENIRQ disabled
+    bus.transfer(CMD_READ_X & ~1);
+    CHECK_EQ(digitalRead(TP_IRQ), LOW);
+    bus.deselect();
+    sim.release();
+    CHECK_EQ(digitalRead(TP_IRQ), HIGH);
+}
+
+
+/**
+ * A touch at the raw values of the default calibration points is
+ * mapped to these points, in all rotations of the display
+ */
+static void testGetTouch()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    touchpad.begin();
+
+    TouchPoint tp;
+    CHECK(! touchpad.getTouch(tp));
+    sim.touch(646, 1034);
+    CHECK(touchpad.getTouch(tp));
+    CHECK_NEAR(tp.x, 40, 1);
+    CHECK_NEAR(tp.y, 40, 1);
+    CHECK_EQ(tp.xValue, 646);
+    CHECK_EQ(tp.yValue, 1034);
+    CHECK_NEAR(tp.rTouch, 400, 10);
+
+    sim.touch(3365, 3165);
+    const int expect[4][2] = {{280, 200}, {200, 40}, {40, 40}, {40, 280}};
+    for (uint8_t r = 0; r < 4; r++)
+    {
+        lcd.setRotation(r);
+        CHECK(touchpad.getTouch(tp));
+        CHECK_NEAR(tp.x, expect[r][0], 1);
+        CHECK_NEAR(tp.y, expect[r][1], 1);
+    }
+    lcd.setRotation(0);
+
+    sim.touch(646, 1034, 5000);    // too light
+    CHECK(! touchpad.getTouch(tp));
+    sim.release();
+    CHECK(! touchpad.getTouch(tp));
+}
+
+
+/**
+ * Gestures are detected from a scripted swipe, sampled by loop()
+ */
+static int swipes = 0;
+static void onSwipeRight(int x, int y) { (void)x; (void)y; swipes++; }
+
+static void testLoop()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    sim.setNoise(4, 4);
+    touchpad.begin();
+    touchpad.addSwipeRightCb(onSwipeRight);
+    sim.play({{ 50, true,  800, 2000, 400},
+              {250, true, 3200, 2000, 400},
+              {260, false,   0,    0,   0}});
+    uint32_t ms = millis();
+    while (millis() - ms < 500) touchpad.loop();
+    CHECK_EQ(swipes, 1);
+}
+
+
+/**
+ * A callback replaced with addShortTouchCb() keeps its place
+ * among the subscribers
+ */
+static std::string order;
+static void onFirst(void *ctx, const TouchEvent &ev) { (void)ctx; (void)ev; order += "1"; }
+static void onLast(void *ctx, const TouchEvent &ev)  { (void)ctx; (void)ev; order += "3"; }
+static void onTapA(int x, int y) { (void)x; (void)y; order += "a"; }
+static void onTapB(int x, int y) { (void)x; (void)y; order += "b"; }
+
+static void testCallbackOrder()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    touchpad.subscribe(TOUCH_SHORT, onFirst, nullptr);
+    touchpad.addShortTouchCb(onTapA);
+    touchpad.subscribe(TOUCH_SHORT, onLast, nullptr);
+    touchpad.addShortTouchCb(onTapB);
+    for (const char *expected : {"1b3", "13"})
+    {
+        order.clear();
+        sim.play({{ 50, true, 2000, 2000, 400},
+                  {150, true, 2000, 2000, 400},
+                  {151, false,   0,    0,   0}});
+        uint32_t ms = millis();
+        while (millis() - ms < 300) touchpad.loop();
+        CHECK(order == expected);
+        touchpad.addShortTouchCb(nullptr);
+    }
+}
+
+
+int main()
+{
+    host::useVirtualTime();
+    testTransports();
+    testPenIrq();
+    testGetTouch();
+    testLoop();
+    testCallbackOrder();
+    return testResult("driver_sim_test");
+}
@@ -0,0 +1,138 @@
+/**
+ * File         event_queue_test.cpp
+ *
+ * Purpose      Stress test of the SPSC queue with a producer and a consumer
+ *              thread. Every element carries its sequence number in all 
+ *              fields, so a torn element, a lost or a duplicated one is 
+ *              detected. Then the sampling task of XPT2046_Bitbang feeds 
+ *              the queue from the simulated controller.
+ */
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+#define NBR_EVENTS 2000000
+
+static LGFX lcd;
+
+static TouchSample makeSample(uint32_t seq)
+{
+    TouchSample s;
+    s.tp = TouchPoint {(int)seq, (int)~seq, (int)(seq * 3), (int)(seq ^ 0x5A5A5A5A), (int)(seq >> 3), (int)(seq * 7)};
+    s.ms = seq;
+    s.penDown = seq & 1;
+    return s;
+}
+
+static bool isIntact(const TouchSample &s)
+{
+    TouchSample e = makeSample(s.ms);
+    return s.tp.x == e.tp.x && s.tp.y == e.tp.y && s.tp.xValue == e.tp.xValue && s.tp.yValue == e.tp.yValue
+        && s.tp.zValue == e.tp.zValue && s.tp.rTouch == e.tp.rTouch && s.penDown == e.penDown;
+}
+
+
+/**
+ * With retry the consumer gets every element in order. Without retry
+ * the elements arrive in order and received + dropped = produced.
+ */
+static void stress(bool retry)
+{
+    std::unique_ptr<EventQueue<TouchSample, XPT2046_QUEUE_SIZE>> q(new EventQueue<TouchSample, XPT2046_QUEUE_SIZE>);
+    EventQueue<TouchSample, XPT2046_QUEUE_SIZE> &queue = *q;
+    std::atomic<bool> done(false);
+    uint32_t refused = 0;
+
+    uint64_t ns = wallNanos();
+    std::thread producer([&]()
+    {
+        for (uint32_t seq = 0; seq < NBR_EVENTS; seq++)
+        {
+            TouchSample s = makeSample(seq);
+            while (! queue.push(s))
+            {
+                refused++;
+                if (! retry) break;
+                std::this_thread::yield();   // the host may have a single core
+            }
+        }
+        done = true;
+    });
+
+    uint32_t received = 0, torn = 0, disorder = 0;
+    int64_t last = -1;
+    TouchSample s;
+    for (;;)
+    {
+        bool finished = done;
+        while (queue.pop(s))
+        {
+            received++;
+            if (! isIntact(s)) torn++;
+            if ((int64_t)s.ms <= last || (retry && s.ms != (uint32_t)(last + 1))) disorder++;
+            last = s.ms;
+        }
+        if (finished) break;
+        std::this_thread::yield();
+    }
+    producer.join();
+    double ms = (wallNanos() - ns) / 1.0e6;
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(disorder, 0);
+    CHECK_EQ(queue.dropped(), refused);
+    CHECK_EQ(received + (retry ? 0 : queue.dropped()), NBR_EVENTS);
+    CHECK(queue.isEmpty());
+    printf("%s: %u events in %.0f ms, %u received, %u dropped\n", 
+           retry ? "retry   " : "no retry", NBR_EVENTS, ms, received, queue.dropped());
+}
+
+
+/**
+ * A tap sampled by the task arrives as samples with the 
+ * pen down followed by one with the pen up
+ */
+static void samplingTask()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    touchpad.begin();
+    sim.play({{ 50, true,  2000, 2000, 400},
+              {250, false,    0,    0,   0}});
+    CHECK(touchpad.startSamplingTask(5));
+
+    int down = 0, up = 0;
+    uint32_t msLast = 0;
+    bool ordered = true;
+    TouchSample s;
+    for (uint32_t ms = millis(); millis() - ms < 400; delay(20))
+    {
+        while (touchpad.readSample(s))
+        {
+            if (s.penDown) down++;
+            else up++;
+            if (s.ms < msLast || (up && s.penDown)) ordered = false;
+            msLast = s.ms;
+        }
+    }
+    touchpad.stopSamplingTask();
+    sim.detach();
+    CHECK(down >= 200 / 5 - 10 && down <= 200 / 5 + 2);
+    CHECK_EQ(up, 1);
+    CHECK(ordered);
+    CHECK_EQ(touchpad.getDroppedSamples(), 0);
+}
+
+
+int main()
+{
+    stress(true);
+    stress(false);
+    samplingTask();
+    return testResult("event_queue_test");
+}
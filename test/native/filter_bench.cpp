@@ -0,0 +1,111 @@
+/**
+ * File         filter_bench.cpp
+ *
+ * Purpose      Jitter and cost of the oversampling filters (XPT2046_Filter.h)
+ *              on raw data recorded from the simulated controller with noise,
+ *              spikes and a settling error of the first conversion after 
+ *              switching the axis. The recording holds the conversions of 
+ *              each axis in the order the driver makes them, so every filter 
+ *              sees the same data. The single conversion of the former 
+ *              getTouch() is the reference.
+ */
+
+#include <math.h>
+#include <vector>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+#define NBR_SAMPLES  4000
+#define BLOCK        10       // conversions recorded per axis and sample
+#define X_TRUE       2000
+#define Y_TRUE       1500
+
+using Stats = struct stat
+{
+    double jitter;   // standard deviation in raw units
+    int    maxError;
+    double ns;       // filter time per sample
+};
+
+
+/**
+ * Applies filter f to N conversions of every recorded block, 
+ * skipping the first one if discard is set
+ */
+template <size_t N, typename F>
+static Stats run(const std::vector<uint16_t> &rec, int truth, bool discard, F f)
+{
+    std::vector<uint16_t> out(rec.size() / BLOCK);
+    uint64_t ns = wallNanos();
+    for (int pass = 0; pass < 10; pass++)
+    {
+        for (size_t b = 0; b < out.size(); b++)
+        {
+            uint16_t v[N];
+            const uint16_t *p = &rec[b * BLOCK + (discard ? 1 : 0)];
+            for (size_t i = 0; i < N; i++) v[i] = p[i];
+            out[b] = f(v);
+        }
+        keep(out);
+    }
+    Stats s = {0, 0, (wallNanos() - ns) / 10.0 / out.size()};
+    for (uint16_t v : out)
+    {
+        int e = (int)v - truth;
+        s.jitter += (double)e * e;
+        if (abs(e) > s.maxError) s.maxError = abs(e);
+    }
+    s.jitter = sqrt(s.jitter / out.size());
+    return s;
+}
+
+
+static void print(const char *name, const Stats &x, const Stats &y, int conversions)
+{
+    printf("%-24s jitter %5.1f %5.1f  max error %4d %4d  %5.1f ns/sample  %3d us/axis at 1 MHz\n",
+           name, x.jitter, y.jitter, x.maxError, y.maxError, (x.ns + y.ns) / 2, conversions * 24);
+}
+
+
+int main()
+{
+    // record the raw conversions as the driver sees them, X and Y alternating
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.setNoise(12, 4);
+    sim.setSpikes(20, 300);
+    sim.setSettleError(40);
+    sim.touch(X_TRUE, Y_TRUE);
+    std::vector<uint16_t> recX, recY;
+    for (int s = 0; s < NBR_SAMPLES; s++)
+    {
+        for (int i = 0; i < BLOCK; i++) recX.push_back(sim.convert(CMD_READ_X));
+        for (int i = 0; i < BLOCK; i++) recY.push_back(sim.convert(CMD_READ_Y));
+    }
+
+    auto single  = [](uint16_t (&v)[1]) { return v[0]; };
+    auto median3 = [](uint16_t (&v)[3]) { return medianOf(v); };
+    auto median5 = [](uint16_t (&v)[5]) { return medianOf(v); };
+    auto median9 = [](uint16_t (&v)[9]) { return medianOf(v); };
+    auto trim8   = [](uint16_t (&v)[8]) { return trimmedMeanOf(v); };
+
+    Stats x1 = run<1>(recX, X_TRUE, false, single), y1 = run<1>(recY, Y_TRUE, false, single);
+    print("single (former)", x1, y1, 1);
+    Stats x, y;
+    x = run<5>(recX, X_TRUE, false, median5); y = run<5>(recY, Y_TRUE, false, median5);
+    print("median 5", x, y, 5);
+    x = run<3>(recX, X_TRUE, true, median3); y = run<3>(recY, Y_TRUE, true, median3);
+    print("discard + median 3", x, y, 4);
+    Stats x5 = run<5>(recX, X_TRUE, true, median5), y5 = run<5>(recY, Y_TRUE, true, median5);
+    print("discard + median 5", x5, y5, 6);
+    x = run<9>(recX, X_TRUE, true, median9); y = run<9>(recY, Y_TRUE, true, median9);
+    print("discard + median 9", x, y, 10);
+    x = run<8>(recX, X_TRUE, true, trim8); y = run<8>(recY, Y_TRUE, true, trim8);
+    print("discard + trimmed mean 8", x, y, 9);
+
+    // the default configuration: discard + median of 5
+    CHECK(x5.jitter * 3 < x1.jitter && y5.jitter * 3 < y1.jitter);
+    CHECK(x5.maxError < 100 && y5.maxError < 100);
+    CHECK(x5.ns < 200 && y5.ns < 200);
+    return testResult("filter_bench");
+}
@@ -0,0 +1,278 @@
+/**
+ * File         gesture_trace_test.cpp
+ *
+ * Purpose      GestureRecognizer fed from touch traces read with TraceReader.
+ *              Synthetic traces of swipes, taps and long touches check the
+ *              gesture and the time at which it fires. A swipe sampled by the
+ *              driver from the simulated controller is recorded and replayed
+ *              offline, the recognizer must report the same events as live.
+ *              Slow and fast drags check the move events: the minimum distance,
+ *              the rate limit, the coalesced dx, dy and the velocity.
+ */
+
+#include <vector>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+
+// the default calibration of the driver
+static const TouchCalibration cal = {2, {{ 40, 40,  646, 1034, 0, 0},
+                                         {280, 200, 3365, 3165, 0, 0}}};
+
+/**
+ * Builds a trace of screen positions with the
+ * raw values of the default calibration
+ */
+class TraceWriter
+{
+    public:
+        TraceWriter() : _data(XPT2046_TRACE_HEADER_SIZE) { packTraceHeader(_data.data()); }
+
+        void add(uint32_t ms, bool penDown, int x = 0, int y = 0)
+        {
+            const TouchPoint &p0 = cal.point[0], &p1 = cal.point[1];
+            TraceRecord r = {ms, penDown, 0, 0, 0};
+            if (penDown)
+            {
+                r.xValue = p0.xValue + (x - p0.x) * (p1.xValue - p0.xValue) / (p1.x - p0.x);
+                r.yValue = p0.yValue + (y - p0.y) * (p1.yValue - p0.yValue) / (p1.y - p0.y);
+                r.zValue = 3000;
+            }
+            _data.resize(_data.size() + XPT2046_TRACE_RECORD_SIZE);
+            packTraceRecord(r, _ms, &_data[_data.size() - XPT2046_TRACE_RECORD_SIZE]);
+            _ms = ms;
+        }
+
+        // straight line from x0, y0 to x1, y1 sampled every step ms, then pen up
+        void stroke(uint32_t ms, int x0, int y0, int x1, int y1, uint32_t duration, uint32_t step = 10)
+        {
+            for (uint32_t t = 0; t <= duration; t += step)
+            {
+                add(ms + t, true, x0 + (x1 - x0) * (int)t / (int)duration, y0 + (y1 - y0) * (int)t / (int)duration);
+            }
+            add(ms + duration + step, false);
+        }
+
+        const std::vector<uint8_t> &data() const { return _data; }
+
+    private:
+        std::vector<uint8_t> _data;
+        uint32_t _ms = 0;
+};
+
+
+/**
+ * Reads the trace through the calibration into the recognizer
+ * and returns the events
+ */
+static std::vector<TouchEvent> replay(const std::vector<uint8_t> &trace)
+{
+    AffineTransform t;
+    TraceReader reader;
+    TraceRecord r;
+    GestureRecognizer g;
+    std::vector<TouchEvent> out;
+    fitAffineTransform(cal, t);
+    CHECK(reader.begin(trace.data(), trace.size()));
+    while (reader.next(r))
+    {
+        int x = 0, y = 0;
+        TouchEvent ev[XPT2046_MAX_EVENTS];
+        if (r.penDown) applyAffineTransform(t, r.xValue, r.yValue, x, y);
+        int n = g.feed(r.penDown, x, y, r.ms, ev);
+        out.insert(out.end(), ev, ev + n);
+    }
+    return out;
+}
+
+
+static std::vector<TouchEvent> gestures(const std::vector<TouchEvent> &events)
+{
+    std::vector<TouchEvent> out;
+    for (const TouchEvent &ev : events) if (ev.type < TOUCH_PEN_DOWN) out.push_back(ev);
+    return out;
+}
+
+
+/**
+ * Swipes in the four directions fire while the pen is still down,
+ * also exactly along an axis
+ */
+static void testSwipes()
+{
+    struct { int x0, y0, x1, y1; TouchEventType type; } swipes[] = {
+        {100, 120, 200, 120, TOUCH_SWIPE_RIGHT}, {200, 120, 100, 130, TOUCH_SWIPE_LEFT},
+        {160, 200, 165, 100, TOUCH_SWIPE_UP},    {160,  60, 160, 160, TOUCH_SWIPE_DOWN}};
+    for (auto &s : swipes)
+    {
+        TraceWriter w;
+        w.stroke(1000, s.x0, s.y0, s.x1, s.y1, 200);
+        std::vector<TouchEvent> g = gestures(replay(w.data()));
+        CHECK_EQ(g.size(), 1);
+        if (g.empty()) continue;
+        CHECK_EQ(g[0].type, s.type);
+        CHECK(g[0].ms < 1000 + 100);    // after 20 of 100 pixels, long before pen up
+    }
+}
+
+
+/**
+ * Taps and long touches, with jitter below the swipe distance
+ */
+static void testTouches()
+{
+    TraceWriter w;
+    w.stroke(1000, 100, 100, 100, 100, 100);                          // tap
+    w.stroke(2000, 100, 100, 100, 100, 20);                           // too short
+    for (uint32_t t = 0; t <= 500; t += 10)                           // held with jitter
+    {
+        int j = (t / 10) % 2 ? XPT2046_SWIPE_MIN_DIST / 3 : -XPT2046_SWIPE_MIN_DIST / 3;
+        w.add(3000 + t, true, 150 + j, 150 - j);
+    }
+    w.add(3510, false);
+    w.stroke(4000, 50, 50, 50, 50, 600);                              // long, held still
+    std::vector<TouchEvent> events = replay(w.data());
+    std::vector<TouchEvent> g = gestures(events);
+    CHECK_EQ(g.size(), 3);
+    if (g.size() != 3) return;
+    CHECK_EQ(g[0].type, TOUCH_SHORT);
+    CHECK_EQ(g[0].duration, 100);
+    CHECK_EQ(g[1].type, TOUCH_LONG);
+    CHECK(g[1].ms > 3000 + XPT2046_LONG_TOUCH_MS && g[1].ms <= 3000 + XPT2046_LONG_TOUCH_MS + 10);
+    CHECK_EQ(g[2].type, TOUCH_LONG);
+    CHECK(g[2].ms < 4600);
+
+    int downs = 0, ups = 0;
+    for (const TouchEvent &ev : events)
+    {
+        if (ev.type == TOUCH_PEN_DOWN) downs++;
+        if (ev.type == TOUCH_PEN_UP) ups++;
+    }
+    CHECK_EQ(downs, 4);
+    CHECK_EQ(ups, 4);
+}
+
+
+static std::vector<TouchEvent> ofType(const std::vector<TouchEvent> &events, TouchEventType type)
+{
+    std::vector<TouchEvent> out;
+    for (const TouchEvent &ev : events) if (ev.type == type) out.push_back(ev);
+    return out;
+}
+
+
+/**
+ * The dx, dy of pen down, moves and pen up add up to the way from
+ * the first to the last position
+ */
+static void checkDisplacement(const std::vector<TouchEvent> &events, int dx, int dy)
+{
+    int sx = 0, sy = 0;
+    for (const TouchEvent &ev : events)
+    {
+        if (ev.type < TOUCH_PEN_DOWN) continue;
+        sx += ev.dx;
+        sy += ev.dy;
+    }
+    CHECK_EQ(sx, events.back().x - events.front().x);
+    CHECK_EQ(sy, events.back().y - events.front().y);
+    CHECK_NEAR(sx, dx, 1);      // the raw values are rounded through the calibration
+    CHECK_NEAR(sy, dy, 1);
+}
+
+
+/**
+ * Moves: none below XPT2046_MOVE_MIN_DIST, at most one per XPT2046_MOVE_MIN_MS,
+ * the samples in between coalesced into the next move
+ */
+static void testMoves()
+{
+    // slow drift of 1 pixel in 400 ms, no move
+    TraceWriter still;
+    still.stroke(1000, 100, 100, 101, 100, 400);
+    std::vector<TouchEvent> events = replay(still.data());
+    CHECK_EQ(ofType(events, TOUCH_MOVE).size(), 0);
+    CHECK_EQ(events.front().type, TOUCH_PEN_DOWN);
+    CHECK_EQ(events.back().type, TOUCH_PEN_UP);
+
+    // slow drag of 1 pixel per 50 ms, a move every XPT2046_MOVE_MIN_DIST pixels
+    TraceWriter slow;
+    slow.stroke(1000, 100, 100, 110, 100, 500);
+    events = replay(slow.data());
+    std::vector<TouchEvent> moves = ofType(events, TOUCH_MOVE);
+    CHECK(moves.size() >= 3 && moves.size() <= 10 / XPT2046_MOVE_MIN_DIST);
+    for (const TouchEvent &m : moves) CHECK(m.dx >= XPT2046_MOVE_MIN_DIST && m.dy == 0);
+    checkDisplacement(events, 10, 0);
+
+    // fast drag of 1000 pixels/s sampled every 5 ms, throttled to XPT2046_MOVE_MIN_MS
+    TraceWriter fast;
+    fast.stroke(1000, 40, 200, 240, 100, 200, 5);
+    events = replay(fast.data());
+    moves = ofType(events, TOUCH_MOVE);
+    CHECK_EQ(moves.size(), 200 / XPT2046_MOVE_MIN_MS);
+    uint32_t msLast = 1000;
+    for (const TouchEvent &m : moves)
+    {
+        CHECK(m.ms - msLast >= XPT2046_MOVE_MIN_MS);
+        CHECK_NEAR(m.dx, 1000 * (int)(m.ms - msLast) / 1000, 2);   // the samples in between are in dx, dy
+        CHECK_NEAR(m.dy, -500 * (int)(m.ms - msLast) / 1000, 2);
+        msLast = m.ms;
+    }
+    checkDisplacement(events, 200, -100);
+    const TouchEvent &last = moves.back();
+    CHECK_NEAR(last.vx, 1000, 100);
+    CHECK_NEAR(last.vy, -500, 100);
+    CHECK_EQ(ofType(events, TOUCH_SWIPE_RIGHT).size(), 1);
+}
+
+
+/**
+ * A swipe recorded from the driver gives the same events offline
+ */
+static std::vector<TouchEvent> live;
+static void onEvent(void *ctx, const TouchEvent &ev) { (void)ctx; live.push_back(ev); }
+
+static void testRecordedSwipe()
+{
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    host::MemoryStream trace;
+    touchpad.begin();
+    for (int t = TOUCH_SHORT; t < TOUCH_EVENT_TYPES; t++) touchpad.subscribe((TouchEventType)t, onEvent);
+    sim.setNoise(4, 4);
+    touchpad.startTrace(trace);
+    sim.play({{ 50, true,  800, 2400, 400},
+              {300, true, 3000, 2000, 400},
+              {301, false,   0,    0,   0}});
+    uint32_t ms = millis();
+    while (millis() - ms < 500) touchpad.loop();
+    touchpad.stopTrace();
+
+    std::vector<TouchEvent> offline = replay(trace.data());
+    CHECK_EQ(offline.size(), live.size());
+    for (size_t i = 0; i < offline.size() && i < live.size(); i++)
+    {
+        CHECK_EQ(offline[i].type, live[i].type);
+        CHECK_EQ(offline[i].x, live[i].x);
+        CHECK_EQ(offline[i].y, live[i].y);
+        CHECK_EQ(offline[i].ms - offline[0].ms, live[i].ms - live[0].ms);
+    }
+    std::vector<TouchEvent> g = gestures(offline);
+    CHECK_EQ(g.size(), 1);
+    if (g.size()) CHECK_EQ(g[0].type, TOUCH_SWIPE_RIGHT);
+    printf("recorded swipe: %u bytes, %u events\n", (unsigned)trace.data().size(), (unsigned)offline.size());
+}
+
+
+int main()
+{
+    host::useVirtualTime();
+    testSwipes();
+    testTouches();
+    testMoves();
+    testRecordedSwipe();
+    return testResult("gesture_trace_test");
+}
@@ -0,0 +1,410 @@
+/**
+ * File         Arduino.cpp
+ *
+ * Purpose      Time, pins, interrupts, Serial and heap of the host build
+ *              (see include/Arduino.h and host/Host.h)
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "Host.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    using Pin = struct hpin
+    {
+        uint8_t  level;
+        uint8_t  mode;
+        int      irqMode;
+        void   (*isr)(void *);
+        void    *arg;
+        void   (*isrNoArg)();
+        uint32_t writes;
+    };
+
+    const int NBR_PINS = 64;
+    const uint64_t NS_PER_MS = 1000000ULL;
+
+    std::recursive_mutex     g_lock;           // pins and devices
+    Pin                      g_pin[NBR_PINS] = {};
+    std::vector<host::PinDevice *> g_devices;
+    std::atomic<bool>        g_virtual(false);
+    std::atomic<uint64_t>    g_virtualNs(0);
+    const Clock::time_point  g_start = Clock::now();
+    std::atomic<uint32_t>    g_restarts(0);
+    std::atomic<size_t>      g_largestFreeBlock(110000);
+    std::atomic<bool>        g_verbose(getenv("HOST_VERBOSE") != nullptr);
+
+    uint64_t realNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_start).count();
+    }
+
+    /**
+     * Sets the level of the pin and calls the 
+     * attached interrupt on a matching edge
+     */
+    void changeLevel(uint8_t pin, uint8_t level)
+    {
+        if (pin >= NBR_PINS) return;
+        Pin &p = g_pin[pin];
+        uint8_t old = p.level;
+        p.level = level ? HIGH : LOW;
+        bool fire = (p.irqMode == CHANGE  && old != p.level)
+                 || (p.irqMode == RISING  && old == LOW  && p.level == HIGH)
+                 || (p.irqMode == FALLING && old == HIGH && p.level == LOW)
+                 || (p.irqMode == ONLOW   && p.level == LOW)
+                 || (p.irqMode == ONHIGH  && p.level == HIGH);
+        if (! fire) return;
+        if (p.isr) p.isr(p.arg);
+        else if (p.isrNoArg) p.isrNoArg();
+    }
+}
+
+
+void hostLog(char level, const char *file, int line, const char *format, ...)
+{
+    if (! g_verbose && level != 'E') return;
+    const char *name = strrchr(file, '/');
+    fprintf(stderr, "[%c][%s:%d] ", level, name ? name + 1 : file, line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    if (pin < NBR_PINS) g_pin[pin].mode = mode;
+}
+
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    if (pin >= NBR_PINS) return;
+    g_pin[pin].writes++;
+    changeLevel(pin, level);
+    for (host::PinDevice *d : g_devices) d->onPinWrite(pin, level ? HIGH : LOW);
+}
+
+
+int digitalRead(uint8_t pin)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    return pin < NBR_PINS ? g_pin[pin].level : LOW;
+}
+
+
+uint8_t digitalPinToInterrupt(uint8_t pin)
+{
+    return pin;
+}
+
+
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    if (pin >= NBR_PINS) return;
+    g_pin[pin].isr = nullptr;
+    g_pin[pin].isrNoArg = fn;
+    g_pin[pin].irqMode = mode;
+}
+
+
+void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    if (pin >= NBR_PINS) return;
+    g_pin[pin].isr = fn;
+    g_pin[pin].arg = arg;
+    g_pin[pin].isrNoArg = nullptr;
+    g_pin[pin].irqMode = mode;
+}
+
+
+void detachInterrupt(uint8_t pin)
+{
+    std::lock_guard<std::recursive_mutex> lock(g_lock);
+    if (pin >= NBR_PINS) return;
+    g_pin[pin].isr = nullptr;
+    g_pin[pin].isrNoArg = nullptr;
+    g_pin[pin].irqMode = 0;
+}
+
+
+uint32_t millis()
+{
+    return (uint32_t)(host::nanos() / NS_PER_MS);
+}
+
+
+uint32_t micros()
+{
+    return (uint32_t)(host::nanos() / 1000ULL);
+}
+
+
+/**
+ * In virtual time every read advances the clock by 4 ns, 
+ * so a busy wait on the counter comes to an end
+ */
+uint32_t hostCycleCount()
+{
+    uint64_t ns = g_virtual ? (g_virtualNs += 4) : realNanos();
+    return (uint32_t)(ns * 6 / 25);
+}
+
+
+uint32_t hostCyclesPerSecond()
+{
+    return 240000000UL;
+}
+
+
+/**
+ * Waits in slices of 1 ms, the devices are 
+ * polled after each slice
+ */
+void delay(uint32_t ms)
+{
+    if (g_virtual)
+    {
+        for (uint32_t i = 0; i < ms; i++) host::advance(NS_PER_MS);
+        std::this_thread::yield();
+        return;
+    }
+    uint64_t end = realNanos() + ms * NS_PER_MS;
+    for (;;)
+    {
+        host::pollDevices();
+        uint64_t now = realNanos();
+        if (now >= end) break;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(end - now, NS_PER_MS)));
+    }
+}
+
+
+void delayMicroseconds(uint32_t us)
+{
+    if (g_virtual)
+    {
+        host::advance(us * 1000ULL);
+        return;
+    }
+    uint64_t end = realNanos() + us * 1000ULL;
+    while (realNanos() < end) {}
+}
+
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    if (inMax == inMin) return outMin;
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+
+size_t Print::write(const uint8_t *buf, size_t size)
+{
+    size_t n = 0;
+    while (size--) n += write(*buf++);
+    return n;
+}
+
+
+size_t Print::printf(const char *format, ...)
+{
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(small)) return write((const uint8_t *)small, len);
+
+    std::vector<char> big(len + 1);
+    va_start(args, format);
+    vsnprintf(big.data(), big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t *)big.data(), len);
+}
+
+
+size_t Print::print(int v)
+{
+    return printf("%d", v);
+}
+
+
+size_t Print::println(const char *s)
+{
+    return print(s) + write("\n");
+}
+
+
+size_t Print::println(int v)
+{
+    return printf("%d\n", v);
+}
+
+
+size_t Stream::readBytes(uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+    while (n < len)
+    {
+        int c = read();
+        if (c < 0) break;
+        buf[n++] = (uint8_t)c;
+    }
+    return n;
+}
+
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return fwrite(&c, 1, 1, stdout);
+}
+
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+    return fwrite(buf, 1, size, stdout);
+}
+
+
+void EspClass::restart()
+{
+    g_restarts++;
+    log_i("==> ESP.restart()");
+}
+
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return size <= g_largestFreeBlock ? malloc(size) : nullptr;
+}
+
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    (void)caps;
+    return g_largestFreeBlock;
+}
+
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    return 2 * g_largestFreeBlock;
+}
+
+
+namespace host
+{
+    void useVirtualTime(bool on)
+    {
+        if (on && ! g_virtual) g_virtualNs = realNanos();
+        g_virtual = on;
+    }
+
+    bool isVirtualTime()
+    {
+        return g_virtual;
+    }
+
+    uint64_t nanos()
+    {
+        return g_virtual ? g_virtualNs.load() : realNanos();
+    }
+
+    void advance(uint64_t ns)
+    {
+        if (! g_virtual) return;
+        g_virtualNs += ns;
+        pollDevices();
+    }
+
+    void attachDevice(PinDevice *device)
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        g_devices.push_back(device);
+    }
+
+    void detachDevice(PinDevice *device)
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        g_devices.erase(std::remove(g_devices.begin(), g_devices.end(), device), g_devices.end());
+    }
+
+    void setPin(uint8_t pin, uint8_t level)
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        changeLevel(pin, level);
+    }
+
+    uint8_t pinLevel(uint8_t pin)
+    {
+        return (uint8_t)digitalRead(pin);
+    }
+
+    uint32_t pinWrites(uint8_t pin)
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        return pin < NBR_PINS ? g_pin[pin].writes : 0;
+    }
+
+    void resetPinCounters()
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        for (Pin &p : g_pin) p.writes = 0;
+    }
+
+    void pollDevices()
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_lock);
+        uint64_t ns = nanos();
+        for (PinDevice *d : g_devices) d->onTime(ns);
+    }
+
+    void setLargestFreeBlock(size_t size)
+    {
+        g_largestFreeBlock = size;
+    }
+
+    uint32_t restarts()
+    {
+        return g_restarts;
+    }
+
+    void setVerbose(bool on)
+    {
+        g_verbose = on;
+    }
+}
@@ -0,0 +1,290 @@
+/**
+ * File         FreeRTOS.cpp
+ *
+ * Purpose      Tasks, notifications, queues and critical sections of the
+ *              host build. A task is a thread, the task control blocks are
+ *              kept until the end of the program, so a handle stays valid
+ *              after the task has ended.
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Host.h"
+
+struct HostTask
+{
+    std::mutex              m;
+    std::condition_variable cv;
+    uint32_t                notify = 0;
+    std::string             name;
+};
+
+struct HostQueue
+{
+    std::mutex              m;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    size_t                  length;
+    size_t                  itemSize;
+};
+
+namespace
+{
+    struct TaskExit {};
+
+    std::mutex g_tasksLock;
+    std::vector<std::unique_ptr<HostTask>> g_tasks;
+    thread_local HostTask *t_self = nullptr;
+    std::recursive_mutex g_critical;
+
+    HostTask *newTask(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(g_tasksLock);
+        g_tasks.emplace_back(new HostTask);
+        g_tasks.back()->name = name;
+        return g_tasks.back().get();
+    }
+
+    HostTask *self()
+    {
+        if (! t_self) t_self = newTask("thread");
+        return t_self;
+    }
+
+    /**
+     * Deadline in ns of the host clock for a wait of ticks ms
+     */
+    uint64_t deadline(TickType_t ticks)
+    {
+        return ticks == portMAX_DELAY ? UINT64_MAX : host::nanos() + ticks * 1000000ULL;
+    }
+
+    /**
+     * Waits on cv for at most 1 ms, in virtual time 
+     * 0.1 ms real time and the clock advances by 1 ms
+     */
+    template <typename Lock, typename Pred>
+    bool waitSlice(std::condition_variable &cv, Lock &lock, uint64_t end, Pred pred)
+    {
+        uint64_t now = host::nanos();
+        if (now >= end) return pred();
+        uint64_t slice = std::min<uint64_t>(end - now, 1000000ULL);
+        if (host::isVirtualTime())
+        {
+            cv.wait_for(lock, std::chrono::microseconds(100), pred);
+            if (pred()) return true;
+            lock.unlock();
+            host::advance(slice);
+            lock.lock();
+        }
+        else
+        {
+            lock.unlock();
+            host::pollDevices();
+            lock.lock();
+            cv.wait_for(lock, std::chrono::nanoseconds(slice), pred);
+        }
+        return pred();
+    }
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)stackDepth; (void)priority; (void)core;
+    HostTask *task = newTask(name);
+    if (handle) *handle = task;
+    std::thread([fn, arg, task]()
+    {
+        t_self = task;
+        try { fn(arg); }
+        catch (const TaskExit &) {}
+    }).detach();
+    return pdPASS;
+}
+
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+
+/**
+ * Only a task can delete itself
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task && task != self())
+    {
+        log_e("vTaskDelete() of another task is not supported");
+        abort();
+    }
+    throw TaskExit();
+}
+
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks);
+}
+
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period)
+{
+    TickType_t wake = *previousWake + period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0) delay(wake - now);
+    *previousWake = wake;
+}
+
+
+TickType_t xTaskGetTickCount()
+{
+    return millis();
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return self();
+}
+
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    (void)task;
+    return 1;
+}
+
+
+BaseType_t xPortGetCoreID()
+{
+    return 1;
+}
+
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> lock(task->m);
+    task->notify++;
+    task->cv.notify_all();
+    return pdPASS;
+}
+
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    HostTask *task = self();
+    uint64_t end = deadline(ticksToWait);
+    std::unique_lock<std::mutex> lock(task->m);
+    auto notified = [task]() { return task->notify > 0; };
+    while (! notified() && host::nanos() < end) waitSlice(task->cv, lock, end, notified);
+    uint32_t value = task->notify;
+    if (value) task->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+
+void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    (void)mux;
+    g_critical.lock();
+}
+
+
+void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    (void)mux;
+    g_critical.unlock();
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    HostQueue *queue = new HostQueue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    uint64_t end = deadline(ticksToWait);
+    std::unique_lock<std::mutex> lock(queue->m);
+    auto space = [queue]() { return queue->items.size() < queue->length; };
+    while (! space() && host::nanos() < end) waitSlice(queue->cv, lock, end, space);
+    if (! space()) return pdFAIL;
+    const uint8_t *p = static_cast<const uint8_t *>(item);
+    queue->items.emplace_back(p, p + queue->itemSize);
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait)
+{
+    uint64_t end = deadline(ticksToWait);
+    std::unique_lock<std::mutex> lock(queue->m);
+    auto filled = [queue]() { return ! queue->items.empty(); };
+    while (! filled() && host::nanos() < end) waitSlice(queue->cv, lock, end, filled);
+    if (! filled()) return pdFAIL;
+    if (queue->itemSize) memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->m);
+    return queue->items.size();
+}
+
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return xQueueCreate(1, 0);
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, nullptr, 0);
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait)
+{
+    return xQueueReceive(sem, nullptr, ticksToWait);
+}
+
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
@@ -0,0 +1,111 @@
+/**
+ * Header       Host.h
+ *
+ * Purpose      Control of the simulated hardware of the host build, 
+ *              see include/Arduino.h. Tests use these functions to drive 
+ *              pins, attach simulated devices, control the time and look 
+ *              at the files written to the simulated SD card.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace host
+{
+    /**
+     * A device connected to pins. onPinWrite() is called when the program
+     * changes the level of a pin, onTime() whenever time has passed, 
+     * e.g. in delay() or while a task waits. The device drives its outputs
+     * with setPin(). All calls are serialized.
+     */
+    class PinDevice
+    {
+        public:
+            virtual ~PinDevice() {}
+            virtual void onPinWrite(uint8_t pin, uint8_t level) { (void)pin; (void)level; }
+            virtual void onTime(uint64_t ns) { (void)ns; }
+    };
+
+    /**
+     * A device on a hardware SPI bus (see include/SPI.h)
+     */
+    class SpiDevice
+    {
+        public:
+            virtual ~SpiDevice() {}
+            virtual void     beginTransaction() {}
+            virtual void     endTransaction() {}
+            virtual uint8_t  transfer(uint8_t data) = 0;
+            virtual uint16_t transfer16(uint16_t data) = 0;
+    };
+
+    using FileWrite = struct fwr
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    /**
+     * A stream reading from and writing to memory,
+     * e.g. to record and replay a touch trace
+     */
+    class MemoryStream : public Stream
+    {
+        public:
+            MemoryStream() {}
+            MemoryStream(const std::vector<uint8_t> &data) : _data(data) {}
+            using  Print::write;
+            size_t write(uint8_t c) override { _data.push_back(c); return 1; }
+            size_t write(const uint8_t *buf, size_t size) override { _data.insert(_data.end(), buf, buf + size); return size; }
+            int    available() override { return (int)(_data.size() - _pos); }
+            int    read() override { return _pos < _data.size() ? _data[_pos++] : -1; }
+            int    peek() override { return _pos < _data.size() ? _data[_pos] : -1; }
+            void   rewind() { _pos = 0; }
+            const std::vector<uint8_t> &data() const { return _data; }
+
+        private:
+            std::vector<uint8_t> _data;
+            size_t _pos = 0;
+    };
+
+    // time
+    void     useVirtualTime(bool on = true);  // time only advances in delay() and while waiting
+    bool     isVirtualTime();
+    uint64_t nanos();                          // since the start of the program
+    void     advance(uint64_t ns);             // virtual time only
+
+    // pins
+    void     attachDevice(PinDevice *device);
+    void     detachDevice(PinDevice *device);
+    void     setPin(uint8_t pin, uint8_t level);     // drives an input, calls the attached interrupt
+    uint8_t  pinLevel(uint8_t pin);
+    uint32_t pinWrites(uint8_t pin);                 // digitalWrite() calls since the last reset
+    void     resetPinCounters();
+    void     pollDevices();
+
+    // hardware SPI, bus is HSPI, VSPI or FSPI
+    void     attachSpiDevice(uint8_t bus, SpiDevice *device);
+
+    // SD card
+    bool     fileExists(const char *path);
+    std::vector<uint8_t> fileData(const char *path);
+    std::vector<FileWrite> fileWrites(const char *path);
+    void     removeAllFiles();
+
+    // NVS behind Preferences
+    void     eraseNvs();
+    uint32_t nvsReads();
+    uint32_t nvsWrites();
+
+    // heap
+    void     setLargestFreeBlock(size_t size);
+
+    // ESP.restart() calls
+    uint32_t restarts();
+
+    // log_x() output to stderr
+    void     setVerbose(bool on);
+}
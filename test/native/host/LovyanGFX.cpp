@@ -0,0 +1,153 @@
+/**
+ * File         LovyanGFX.cpp
+ *
+ * Purpose      Framebuffer of the simulated display of the host build
+ */
+
+#include <LovyanGFX.hpp>
+#include <stdlib.h>
+
+namespace lgfx
+{
+    namespace fonts
+    {
+        const GFXfont DejaVu18 {};
+        const IFont Font2 {};
+    }
+
+
+    LGFX_Device::LGFX_Device() : _fb(TFT_WIDTH * TFT_HEIGHT, 0)
+    {}
+
+
+    int32_t LGFX_Device::width() const
+    {
+        return (_rotation & 1) ? TFT_HEIGHT : TFT_WIDTH;
+    }
+
+
+    int32_t LGFX_Device::height() const
+    {
+        return (_rotation & 1) ? TFT_WIDTH : TFT_HEIGHT;
+    }
+
+
+    /**
+     * Index into the framebuffer of the point x, y in the 
+     * current rotation, -1 if it is outside the screen
+     */
+    int32_t LGFX_Device::_native(int32_t x, int32_t y) const
+    {
+        if (x < 0 || y < 0 || x >= width() || y >= height()) return -1;
+        int32_t nx, ny;
+        switch (_rotation)
+        {
+            case 1:  nx = y;                 ny = TFT_HEIGHT - 1 - x; break;
+            case 2:  nx = TFT_WIDTH - 1 - x; ny = TFT_HEIGHT - 1 - y; break;
+            case 3:  nx = TFT_WIDTH - 1 - y; ny = x;                  break;
+            default: nx = x;                 ny = y;                  break;
+        }
+        return ny * TFT_WIDTH + nx;
+    }
+
+
+    uint32_t LGFX_Device::color888(uint32_t c)
+    {
+        uint32_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+        return ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+    }
+
+
+    void LGFX_Device::setPixel888(int32_t x, int32_t y, uint32_t rgb)
+    {
+        int32_t i = _native(x, y);
+        if (i >= 0) _fb[i] = rgb & 0xFFFFFF;
+    }
+
+
+    uint32_t LGFX_Device::pixel888(int32_t x, int32_t y) const
+    {
+        int32_t i = _native(x, y);
+        return i >= 0 ? _fb[i] : 0;
+    }
+
+
+    void LGFX_Device::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
+    {
+        uint32_t rgb = color888(color);
+        int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int32_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int32_t err = dx + dy;
+        for (;;)
+        {
+            setPixel888(x0, y0, rgb);
+            if (x0 == x1 && y0 == y1) break;
+            int32_t e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x0 += sx; }
+            if (e2 <= dx) { err += dx; y0 += sy; }
+        }
+    }
+
+
+    void LGFX_Device::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+    {
+        if (w <= 0 || h <= 0) return;
+        drawLine(x, y, x + w - 1, y, color);
+        drawLine(x, y + h - 1, x + w - 1, y + h - 1, color);
+        drawLine(x, y, x, y + h - 1, color);
+        drawLine(x + w - 1, y, x + w - 1, y + h - 1, color);
+    }
+
+
+    void LGFX_Device::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+    {
+        uint32_t rgb = color888(color);
+        for (int32_t j = y; j < y + h; j++)
+            for (int32_t i = x; i < x + w; i++) setPixel888(i, j, rgb);
+    }
+
+
+    void LGFX_Device::drawCircle(int32_t x0, int32_t y0, int32_t r, uint32_t color)
+    {
+        uint32_t rgb = color888(color);
+        int32_t x = r, y = 0, err = 1 - r;
+        while (x >= y)
+        {
+            setPixel888(x0 + x, y0 + y, rgb); setPixel888(x0 - x, y0 + y, rgb);
+            setPixel888(x0 + x, y0 - y, rgb); setPixel888(x0 - x, y0 - y, rgb);
+            setPixel888(x0 + y, y0 + x, rgb); setPixel888(x0 - y, y0 + x, rgb);
+            setPixel888(x0 + y, y0 - x, rgb); setPixel888(x0 - y, y0 - x, rgb);
+            y++;
+            if (err < 0) err += 2 * y + 1;
+            else { x--; err += 2 * (y - x) + 1; }
+        }
+    }
+
+
+    void LGFX_Device::readRect(int32_t x, int32_t y, int32_t w, int32_t h, rgb888_t *data)
+    {
+        _readRects++;
+        uint8_t *p = reinterpret_cast<uint8_t *>(data);
+        for (int32_t j = y; j < y + h; j++)
+            for (int32_t i = x; i < x + w; i++)
+            {
+                uint32_t c = pixel888(i, j);
+                *p++ = c >> 8;    // g
+                *p++ = c >> 16;   // r
+                *p++ = c;         // b
+            }
+    }
+
+
+    void LGFX_Device::readRect(int32_t x, int32_t y, int32_t w, int32_t h, rgb565_t *data)
+    {
+        _readRects++;
+        uint16_t *p = reinterpret_cast<uint16_t *>(data);
+        for (int32_t j = y; j < y + h; j++)
+            for (int32_t i = x; i < x + w; i++)
+            {
+                uint32_t c = pixel888(i, j);
+                *p++ = (uint16_t)(((c & 0xF8) << 8) | ((c >> 18) & 0x3F) << 5 | ((c >> 11) & 0x1F));
+            }
+    }
+}
@@ -0,0 +1,183 @@
+/**
+ * File         Preferences.cpp
+ *
+ * Purpose      In-memory NVS behind Preferences and nvs_flash of the host build
+ */
+
+#include <Preferences.h>
+#include <nvs_flash.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "Host.h"
+
+namespace
+{
+    enum ValueType { TYPE_INT, TYPE_BLOB };
+
+    using Value = struct nval
+    {
+        ValueType type;
+        std::vector<uint8_t> bytes;
+    };
+
+    using Namespace = std::map<std::string, Value>;
+
+    std::mutex g_lock;
+    std::map<std::string, Namespace> g_nvs;
+    std::atomic<uint32_t> g_reads(0);
+    std::atomic<uint32_t> g_writes(0);
+}
+
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partition)
+{
+    (void)partition;
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (_open) return false;
+    if (readOnly && g_nvs.find(name) == g_nvs.end()) return false;
+    g_nvs[name];
+    _ns = name;
+    _open = true;
+    _readOnly = readOnly;
+    return true;
+}
+
+
+void Preferences::end()
+{
+    _open = false;
+}
+
+
+bool Preferences::clear()
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open || _readOnly) return false;
+    g_writes++;
+    g_nvs[_ns].clear();
+    return true;
+}
+
+
+bool Preferences::remove(const char *key)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open || _readOnly) return false;
+    g_writes++;
+    return g_nvs[_ns].erase(key) > 0;
+}
+
+
+bool Preferences::isKey(const char *key)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open) return false;
+    g_reads++;
+    return g_nvs[_ns].count(key) > 0;
+}
+
+
+size_t Preferences::putInt(const char *key, int32_t value)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open || _readOnly) return 0;
+    g_writes++;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&value);
+    g_nvs[_ns][key] = Value {TYPE_INT, std::vector<uint8_t>(p, p + sizeof(value))};
+    return sizeof(value);
+}
+
+
+int32_t Preferences::getInt(const char *key, int32_t defaultValue)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open) return defaultValue;
+    g_reads++;
+    Namespace &ns = g_nvs[_ns];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.type != TYPE_INT) return defaultValue;
+    int32_t value;
+    memcpy(&value, it->second.bytes.data(), sizeof(value));
+    return value;
+}
+
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open || _readOnly || ! value || ! len) return 0;
+    g_writes++;
+    const uint8_t *p = static_cast<const uint8_t *>(value);
+    g_nvs[_ns][key] = Value {TYPE_BLOB, std::vector<uint8_t>(p, p + len)};
+    return len;
+}
+
+
+/**
+ * Like the original, nothing is read if 
+ * the value does not fit into the buffer
+ */
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open || ! buf) return 0;
+    g_reads++;
+    Namespace &ns = g_nvs[_ns];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.type != TYPE_BLOB) return 0;
+    size_t len = it->second.bytes.size();
+    if (len > maxLen)
+    {
+        log_e("not enough space in buffer: %u < %u", (unsigned)maxLen, (unsigned)len);
+        return 0;
+    }
+    memcpy(buf, it->second.bytes.data(), len);
+    return len;
+}
+
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (! _open) return 0;
+    g_reads++;
+    Namespace &ns = g_nvs[_ns];
+    auto it = ns.find(key);
+    return (it == ns.end() || it->second.type != TYPE_BLOB) ? 0 : it->second.bytes.size();
+}
+
+
+esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_flash_erase()
+{
+    host::eraseNvs();
+    return ESP_OK;
+}
+
+
+namespace host
+{
+    void eraseNvs()
+    {
+        std::lock_guard<std::mutex> lock(g_lock);
+        g_nvs.clear();
+        g_writes++;
+    }
+
+    uint32_t nvsReads()
+    {
+        return g_reads;
+    }
+
+    uint32_t nvsWrites()
+    {
+        return g_writes;
+    }
+}
@@ -0,0 +1,230 @@
+/**
+ * File         SD.cpp
+ *
+ * Purpose      In-memory file system of the simulated SD card
+ *              and SPIClass of the host build
+ */
+
+#include <SD.h>
+#include <SPI.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "Host.h"
+
+struct HostFileNode
+{
+    std::vector<uint8_t> data;
+    std::vector<host::FileWrite> writes;
+};
+
+SDFS SD;
+SPIClass SDFS::_defaultSpi(VSPI);
+
+namespace
+{
+    std::mutex g_lock;
+    std::map<std::string, std::shared_ptr<HostFileNode>> g_files;
+    host::SpiDevice *g_spiDevice[4] = {};
+
+    std::shared_ptr<HostFileNode> node(const char *path)
+    {
+        std::lock_guard<std::mutex> lock(g_lock);
+        auto it = g_files.find(path);
+        return it == g_files.end() ? nullptr : it->second;
+    }
+}
+
+
+File::File(std::shared_ptr<HostFileNode> node, const char *name, bool append) : 
+           _node(node), _name(name), _pos(append ? node->data.size() : 0)
+{}
+
+
+size_t File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+    if (! _node || ! size) return 0;
+    std::vector<uint8_t> &data = _node->data;
+    if (_pos + size > data.size()) data.resize(_pos + size);
+    memcpy(data.data() + _pos, buf, size);
+    _node->writes.push_back(host::FileWrite {_pos, size});
+    _pos += size;
+    return size;
+}
+
+
+int File::available()
+{
+    return _node ? (int)(_node->data.size() - std::min(_pos, _node->data.size())) : 0;
+}
+
+
+int File::read()
+{
+    return available() > 0 ? _node->data[_pos++] : -1;
+}
+
+
+int File::peek()
+{
+    return available() > 0 ? _node->data[_pos] : -1;
+}
+
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+    size_t n = std::min(size, (size_t)available());
+    if (n) memcpy(buf, _node->data.data() + _pos, n);
+    _pos += n;
+    return n;
+}
+
+
+bool File::seek(uint32_t pos)
+{
+    if (! _node || pos > _node->data.size()) return false;
+    _pos = pos;
+    return true;
+}
+
+
+size_t File::size() const
+{
+    return _node ? _node->data.size() : 0;
+}
+
+
+void File::close()
+{
+    _node = nullptr;
+}
+
+
+bool SDFS::begin(uint8_t ssPin, SPIClass &spi, uint32_t frequency)
+{
+    (void)ssPin; (void)spi; (void)frequency;
+    return true;
+}
+
+
+/**
+ * Modes "r", "w" (truncates) and "a"
+ */
+File SDFS::open(const char *path, const char *mode)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    auto it = g_files.find(path);
+    if (mode[0] == 'w' || (mode[0] == 'a' && it == g_files.end()))
+    {
+        std::shared_ptr<HostFileNode> fresh(new HostFileNode);
+        g_files[path] = fresh;
+        return File(fresh, path, false);
+    }
+    if (it == g_files.end()) return File();
+    return File(it->second, path, mode[0] == 'a');
+}
+
+
+bool SDFS::exists(const char *path)
+{
+    return node(path) != nullptr;
+}
+
+
+bool SDFS::remove(const char *path)
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    return g_files.erase(path) > 0;
+}
+
+
+uint64_t SDFS::usedBytes()
+{
+    std::lock_guard<std::mutex> lock(g_lock);
+    uint64_t n = 0;
+    for (auto &f : g_files) n += f.second->data.size();
+    return n;
+}
+
+
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss)
+{
+    (void)sck; (void)miso; (void)mosi; (void)ss;
+}
+
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+    _clock = settings.clock ? settings.clock : 1000000;
+    _inTransaction = true;
+    if (g_spiDevice[_bus & 3]) g_spiDevice[_bus & 3]->beginTransaction();
+}
+
+
+void SPIClass::endTransaction()
+{
+    _inTransaction = false;
+    if (g_spiDevice[_bus & 3]) g_spiDevice[_bus & 3]->endTransaction();
+}
+
+
+void SPIClass::_clockOut(int bits)
+{
+    uint64_t ns = bits * 1000000000ULL / _clock;
+    if (host::isVirtualTime()) host::advance(ns);
+    else for (uint64_t end = host::nanos() + ns; host::nanos() < end; ) {}
+}
+
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+    _clockOut(8);
+    host::SpiDevice *d = g_spiDevice[_bus & 3];
+    return d ? d->transfer(data) : 0xFF;
+}
+
+
+uint16_t SPIClass::transfer16(uint16_t data)
+{
+    _clockOut(16);
+    host::SpiDevice *d = g_spiDevice[_bus & 3];
+    return d ? d->transfer16(data) : 0xFFFF;
+}
+
+
+namespace host
+{
+    bool fileExists(const char *path)
+    {
+        return node(path) != nullptr;
+    }
+
+    std::vector<uint8_t> fileData(const char *path)
+    {
+        std::shared_ptr<HostFileNode> n = node(path);
+        return n ? n->data : std::vector<uint8_t>();
+    }
+
+    std::vector<FileWrite> fileWrites(const char *path)
+    {
+        std::shared_ptr<HostFileNode> n = node(path);
+        return n ? n->writes : std::vector<FileWrite>();
+    }
+
+    void removeAllFiles()
+    {
+        std::lock_guard<std::mutex> lock(g_lock);
+        g_files.clear();
+    }
+
+    void attachSpiDevice(uint8_t bus, SpiDevice *device)
+    {
+        g_spiDevice[bus & 3] = device;
+    }
+}
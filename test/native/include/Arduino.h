@@ -0,0 +1,128 @@
+/**
+ * Header       Arduino.h (host stand-in)
+ *
+ * Purpose      The part of the Arduino core for the ESP32 used by the touch
+ *              library and the screenshot routines, for the host build of the
+ *              tests in test/native. Pins, time, interrupts and Serial are
+ *              simulated by the functions in host/Host.h:
+ *                - digitalWrite() / digitalRead() go to the simulated devices
+ *                  attached to the pins, e.g. the XPT2046 in sim/XPT2046Sim.h
+ *                - an interrupt attached to a pin is called when a device
+ *                  changes the level of the pin
+ *                - millis(), micros() and hostCycleCount() run in real time or,
+ *                  after host::useVirtualTime(), in a virtual time advanced by
+ *                  delay() and by waiting, so tests do not depend on the speed
+ *                  of the PC
+ *              The log_x() macros print to stderr if HOST_VERBOSE is set.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0x01
+#define OUTPUT        0x03
+#define INPUT_PULLUP  0x05
+#define RISING        0x01
+#define FALLING       0x02
+#define CHANGE        0x03
+#define ONLOW         0x04
+#define ONHIGH        0x05
+
+#define IRAM_ATTR
+
+void hostLog(char level, const char *file, int line, const char *format, ...) __attribute__((format(printf, 4, 5)));
+#define log_e(format, ...) hostLog('E', __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define log_w(format, ...) hostLog('W', __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define log_i(format, ...) hostLog('I', __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define log_d(format, ...) hostLog('D', __FILE__, __LINE__, format, ##__VA_ARGS__)
+
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t level);
+int      digitalRead(uint8_t pin);
+uint8_t  digitalPinToInterrupt(uint8_t pin);
+void     attachInterrupt(uint8_t pin, void (*fn)(void), int mode);
+void     attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode);
+void     detachInterrupt(uint8_t pin);
+
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+void     delayMicroseconds(uint32_t us);
+void     yield();
+uint32_t hostCycleCount();         // 240 MHz like the CPU of the ESP32
+uint32_t hostCyclesPerSecond();
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+
+class Print
+{
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buf, size_t size);
+        size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s) { return write(s); }
+        size_t print(int v);
+        size_t println(const char *s = "");
+        size_t println(int v);
+        virtual void flush() {}
+};
+
+
+class Stream : public Print
+{
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        size_t readBytes(uint8_t *buf, size_t len);
+        size_t readBytes(char *buf, size_t len) { return readBytes((uint8_t *)buf, len); }
+        void   setTimeout(unsigned long) {}
+};
+
+
+class HardwareSerial : public Stream
+{
+    public:
+        void   begin(unsigned long) {}
+        using  Print::write;
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buf, size_t size) override;
+        int    available() override { return 0; }
+        int    read() override { return -1; }
+        int    peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+
+class EspClass
+{
+    public:
+        void     restart();                 // counted in host::restarts(), returns
+        uint32_t getCycleCount() { return hostCycleCount(); }
+        uint32_t getCpuFreqMHz() { return hostCyclesPerSecond() / 1000000UL; }
+        uint32_t getFreeHeap()   { return 200000; }
+};
+
+extern EspClass ESP;
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
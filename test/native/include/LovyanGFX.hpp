@@ -0,0 +1,192 @@
+/**
+ * Header       LovyanGFX.hpp (host stand-in)
+ *
+ * Purpose      The part of LovyanGFX used by the touch library and the 
+ *              screenshot routines, for the host build of the tests.
+ *              The panel is a framebuffer of TFT_WIDTH x TFT_HEIGHT pixels 
+ *              in the native orientation holding 0xRRGGBB. The drawing 
+ *              functions take RGB565 colors, text is not rendered.
+ *              readRect() returns the pixels in the channel order in which
+ *              the ILI9341 of the CYD delivers them, so the color rotations
+ *              in saveBMPtoSD.cpp are needed as on the hardware:
+ *                rgb888_t  bytes g, r, b per pixel
+ *                rgb565_t  b (5 bits) << 11 | r (6 bits) << 5 | g (5 bits)
+ *              setPixel888() / pixel888() give the tests direct access 
+ *              to the screen in the current rotation, readRects() counts
+ *              the panel transactions of readRect().
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+#define HSPI_HOST        1
+#define VSPI_HOST        2
+#define SPI_DMA_CH_AUTO  3
+
+#define TFT_BLACK   0x0000
+#define TFT_NAVY    0x000F
+#define TFT_BLUE    0x001F
+#define TFT_GREEN   0x07E0
+#define TFT_CYAN    0x07FF
+#define TFT_RED     0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW  0xFFE0
+#define TFT_WHITE   0xFFFF
+
+namespace lgfx
+{
+    struct rgb565_t
+    {
+        union
+        {
+            struct { uint16_t b5:5; uint16_t g6:6; uint16_t r5:5; };
+            uint16_t raw;
+        };
+    };
+
+    struct rgb888_t
+    {
+        uint8_t b;
+        uint8_t g;
+        uint8_t r;
+    };
+
+#pragma pack(push, 1)
+    struct bitmap_header_t
+    {
+        uint16_t bfType;
+        uint32_t bfSize;
+        uint16_t bfReserved1;
+        uint16_t bfReserved2;
+        uint32_t bfOffBits;
+        uint32_t biSize;
+        int32_t  biWidth;
+        int32_t  biHeight;
+        uint16_t biPlanes;
+        uint16_t biBitCount;
+        uint32_t biCompression;
+        uint32_t biSizeImage;
+        int32_t  biXPelsPerMeter;
+        int32_t  biYPelsPerMeter;
+        uint32_t biClrUsed;
+        uint32_t biClrImportant;
+    };
+#pragma pack(pop)
+
+    struct IFont {};
+    struct GFXfont : public IFont {};
+    namespace fonts { extern const GFXfont DejaVu18; extern const IFont Font2; }
+
+    namespace textdatum
+    {
+        enum textdatum_t { top_left = 0, top_center = 1, top_right = 2, middle_left = 4,
+                           middle_center = 5, middle_right = 6, bottom_left = 8, 
+                           bottom_center = 9, bottom_right = 10,
+                           TL_DATUM = top_left, MC_DATUM = middle_center };
+    }
+    using textdatum_t = textdatum::textdatum_t;
+
+    struct Bus_SPI
+    {
+        struct config_t 
+        { 
+            int spi_host, spi_mode, freq_write, freq_read; 
+            bool spi_3wire, use_lock; 
+            int dma_channel, pin_sclk, pin_mosi, pin_miso, pin_dc; 
+        };
+        config_t config() const { return _cfg; }
+        void config(const config_t &cfg) { _cfg = cfg; }
+        config_t _cfg = {};
+    };
+
+    struct Light_PWM
+    {
+        struct config_t { int pin_bl; bool invert; int freq, pwm_channel; };
+        config_t config() const { return _cfg; }
+        void config(const config_t &cfg) { _cfg = cfg; }
+        config_t _cfg = {};
+    };
+
+    struct Touch_XPT2046
+    {
+        struct config_t 
+        { 
+            int x_min, x_max, y_min, y_max, pin_int; 
+            bool bus_shared; 
+            int offset_rotation, spi_host, freq, pin_sclk, pin_mosi, pin_miso, pin_cs; 
+        };
+        config_t config() const { return _cfg; }
+        void config(const config_t &cfg) { _cfg = cfg; }
+        config_t _cfg = {};
+    };
+
+    struct Panel_ILI9341
+    {
+        struct config_t 
+        { 
+            int pin_cs, pin_rst, pin_busy, memory_width, memory_height, panel_width, panel_height, 
+                offset_x, offset_y, offset_rotation, dummy_read_pixel, dummy_read_bits; 
+            bool readable, invert, rgb_order, dlen_16bit, bus_shared; 
+        };
+        config_t config() const { return _cfg; }
+        void config(const config_t &cfg) { _cfg = cfg; }
+        void setBus(Bus_SPI *) {}
+        void setLight(Light_PWM *) {}
+        void setTouch(Touch_XPT2046 *) {}
+        config_t _cfg = {};
+    };
+
+    class LGFX_Device : public Print
+    {
+        public:
+            LGFX_Device();
+            bool    begin() { return true; }
+            bool    init()  { return true; }
+            void    setPanel(Panel_ILI9341 *) {}
+            int32_t width() const;
+            int32_t height() const;
+            uint8_t getRotation() const { return _rotation; }
+            void    setRotation(uint8_t r) { _rotation = r & 3; }
+            void    setBrightness(uint8_t) {}
+            int     getColorDepth() const { return 16; }
+            bool    isEPD() const { return false; }
+
+            void clear(uint32_t color = TFT_BLACK) { fillScreen(color); }
+            void fillScreen(uint32_t color) { fillRect(0, 0, width(), height(), color); }
+            void drawPixel(int32_t x, int32_t y, uint32_t color) { setPixel888(x, y, color888(color)); }
+            void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+            void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+            void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+            void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+            void readRect(int32_t x, int32_t y, int32_t w, int32_t h, rgb888_t *data);
+            void readRect(int32_t x, int32_t y, int32_t w, int32_t h, rgb565_t *data);
+
+            size_t write(uint8_t) override { return 1; }
+            void  setCursor(int32_t, int32_t) {}
+            void  setTextSize(float) {}
+            void  setTextSize(float, float) {}
+            float getTextSizeX() const { return 1.0f; }
+            float getTextSizeY() const { return 1.0f; }
+            void  setTextColor(uint32_t) {}
+            void  setTextColor(uint32_t, uint32_t) {}
+            void  setTextDatum(textdatum_t) {}
+            void  setTextDatum(uint8_t) {}
+            void  setFont(const IFont *) {}
+            size_t drawString(const char *, int32_t, int32_t) { return 0; }
+            void  calibrateTouch(uint16_t *data, uint32_t, uint32_t, int) { for (int i = 0; data && i < 8; i++) data[i] = 0; }
+
+            void     setPixel888(int32_t x, int32_t y, uint32_t rgb);
+            uint32_t pixel888(int32_t x, int32_t y) const;
+            static uint32_t color888(uint32_t color565);
+            uint32_t readRects() const { return _readRects; }
+
+        private:
+            std::vector<uint32_t> _fb;   // 0xRRGGBB, native orientation
+            uint8_t _rotation = 0;
+            uint32_t _readRects = 0;
+            int32_t _native(int32_t x, int32_t y) const;
+    };
+}
+
+using namespace lgfx;
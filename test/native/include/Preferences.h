@@ -0,0 +1,36 @@
+/**
+ * Header       Preferences.h (host stand-in)
+ *
+ * Purpose      Preferences of the ESP32 Arduino core backed by an in-memory
+ *              key/value store, which outlives the Preferences objects like the
+ *              NVS outlives a restart. The behavior follows the original where
+ *              the touch library depends on it:
+ *                - begin() of a namespace that does not exist fails read only
+ *                - getInt() returns the default for a missing key or another type
+ *                - getBytes() returns 0 if the buffer is smaller than the value
+ *              host::nvsReads() / host::nvsWrites() count the accesses.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <string>
+
+class Preferences
+{
+    public:
+        bool   begin(const char *name, bool readOnly = false, const char *partition = nullptr);
+        void   end();
+        bool   clear();
+        bool   remove(const char *key);
+        bool   isKey(const char *key);
+        size_t putInt(const char *key, int32_t value);
+        int32_t getInt(const char *key, int32_t defaultValue = 0);
+        size_t putBytes(const char *key, const void *value, size_t len);
+        size_t getBytes(const char *key, void *buf, size_t maxLen);
+        size_t getBytesLength(const char *key);
+
+    private:
+        std::string _ns;
+        bool _open = false;
+        bool _readOnly = false;
+};
@@ -0,0 +1,63 @@
+/**
+ * Header       SD.h (host stand-in)
+ *
+ * Purpose      SD card of the ESP32 Arduino core backed by an in-memory file
+ *              system. Every write to a file is logged with offset and size,
+ *              host::fileWrites(), so tests can check the alignment of the
+ *              writes to the card. host::fileData() returns the content.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <SPI.h>
+#include <memory>
+#include <string>
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+struct HostFileNode;
+
+class File : public Stream
+{
+    public:
+        File() {}
+        File(std::shared_ptr<HostFileNode> node, const char *name, bool append);
+        using Print::write;
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buf, size_t size) override;
+        int    available() override;
+        int    read() override;
+        int    peek() override;
+        size_t read(uint8_t *buf, size_t size);
+        bool   seek(uint32_t pos);
+        size_t position() const { return _pos; }
+        size_t size() const;
+        const char *name() const { return _name.c_str(); }
+        void   flush() override {}
+        void   close();
+        bool   isDirectory() const { return false; }
+        operator bool() const { return _node != nullptr; }
+
+    private:
+        std::shared_ptr<HostFileNode> _node;
+        std::string _name;
+        size_t _pos = 0;
+};
+
+class SDFS
+{
+    public:
+        bool begin(uint8_t ssPin = 5, SPIClass &spi = _defaultSpi, uint32_t frequency = 4000000);
+        File open(const char *path, const char *mode = "r");
+        bool exists(const char *path);
+        bool remove(const char *path);
+        sdcard_type_t cardType() { return CARD_SDHC; }
+        uint64_t cardSize()   { return 4ULL << 30; }
+        uint64_t totalBytes() { return 4ULL << 30; }
+        uint64_t usedBytes();
+
+    private:
+        static SPIClass _defaultSpi;
+};
+
+extern SDFS SD;
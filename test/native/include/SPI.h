@@ -0,0 +1,51 @@
+/**
+ * Header       SPI.h (host stand-in)
+ *
+ * Purpose      SPIClass of the ESP32 Arduino core. The transfers go to the 
+ *              device attached with host::attachSpiDevice() to the host of 
+ *              the SPIClass, e.g. the simulated XPT2046 in sim/XPT2046Sim.h.
+ *              A transfer blocks for the time the bits take at the clock 
+ *              rate of the transaction, like the polling driver of the core.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define FSPI      1
+#define HSPI      2
+#define VSPI      3
+#define MSBFIRST  1
+#define LSBFIRST  0
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+class SPISettings
+{
+    public:
+        SPISettings() {}
+        SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+        uint32_t clock = 1000000;
+        uint8_t  bitOrder = MSBFIRST;
+        uint8_t  dataMode = SPI_MODE0;
+};
+
+class SPIClass
+{
+    public:
+        SPIClass(uint8_t spiBus = HSPI) : _bus(spiBus) {}
+        void     begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1);
+        void     end() {}
+        void     beginTransaction(SPISettings settings);
+        void     endTransaction();
+        uint8_t  transfer(uint8_t data);
+        uint16_t transfer16(uint16_t data);
+        uint8_t  bus() const { return _bus; }
+
+    private:
+        uint8_t  _bus;
+        bool     _inTransaction = false;
+        uint32_t _clock = 1000000;
+        void     _clockOut(int bits);
+};
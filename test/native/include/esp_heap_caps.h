@@ -0,0 +1,22 @@
+/**
+ * Header       esp_heap_caps.h (host stand-in)
+ *
+ * Purpose      Capability based allocation for the host build. All memory
+ *              comes from malloc(), the largest free block can be limited
+ *              with host::setLargestFreeBlock() to test the fallbacks.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_EXEC      (1 << 0)
+#define MALLOC_CAP_32BIT     (1 << 1)
+#define MALLOC_CAP_8BIT      (1 << 2)
+#define MALLOC_CAP_DMA       (1 << 3)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+
+void  *heap_caps_malloc(size_t size, uint32_t caps);
+void   heap_caps_free(void *ptr);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
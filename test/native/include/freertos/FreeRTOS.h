@@ -0,0 +1,39 @@
+/**
+ * Header       freertos/FreeRTOS.h (host stand-in)
+ *
+ * Purpose      Types and critical sections of FreeRTOS for the host build.
+ *              A tick is 1 ms like on the ESP32 Arduino core. Tasks are threads
+ *              (see freertos/task.h), a critical section locks one mutex shared
+ *              by all portMUX_TYPE instances.
+ */
+
+#pragma once
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+
+struct HostTask;
+struct HostQueue;
+typedef HostTask  *TaskHandle_t;
+typedef HostQueue *QueueHandle_t;
+typedef HostQueue *SemaphoreHandle_t;
+
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define portTICK_PERIOD_MS  1
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux);
+void portEXIT_CRITICAL(portMUX_TYPE *mux);
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR()        do { } while (0)
@@ -0,0 +1,14 @@
+/**
+ * Header       freertos/queue.h (host stand-in)
+ *
+ * Purpose      Queues of fixed size items for the host build
+ */
+
+#pragma once
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t    xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait);
+BaseType_t    xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t queue);
+void          vQueueDelete(QueueHandle_t queue);
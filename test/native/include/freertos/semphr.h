@@ -0,0 +1,14 @@
+/**
+ * Header       freertos/semphr.h (host stand-in)
+ *
+ * Purpose      Binary semaphores for the host build, 
+ *              a queue of length 1 with items of size 0
+ */
+
+#pragma once
+#include "queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait);
+void              vSemaphoreDelete(SemaphoreHandle_t sem);
@@ -0,0 +1,29 @@
+/**
+ * Header       freertos/task.h (host stand-in)
+ *
+ * Purpose      Tasks and direct to task notifications for the host build.
+ *              A task runs in its own thread, vTaskDelete(nullptr) ends it.
+ *              The thread calling a function first (e.g. main()) is a task too.
+ *              Priorities and cores are ignored.
+ */
+
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t   xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                     UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+BaseType_t   xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                         UBaseType_t priority, TaskHandle_t *handle);
+void         vTaskDelete(TaskHandle_t task);
+void         vTaskDelay(TickType_t ticks);
+void         vTaskDelayUntil(TickType_t *previousWake, TickType_t period);
+TickType_t   xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t  uxTaskPriorityGet(TaskHandle_t task);
+BaseType_t   xPortGetCoreID();
+
+BaseType_t   xTaskNotifyGive(TaskHandle_t task);
+void         vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+uint32_t     ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
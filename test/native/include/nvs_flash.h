@@ -0,0 +1,14 @@
+/**
+ * Header       nvs_flash.h (host stand-in)
+ *
+ * Purpose      Erasing the NVS clears the key/value store behind Preferences
+ */
+
+#pragma once
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
@@ -0,0 +1,95 @@
+/**
+ * File         irq_sim_test.cpp
+ *
+ * Purpose      PENIRQ mode against the simulated IRQ line: no bus traffic
+ *              while the pen is up, waitForTouch() wakes on the falling 
+ *              edge of PENIRQ and loop() sleeps while nobody touches.
+ *              A touch after the pen was lifted starts a new pressure detection,
+ *              a touch too light for the pen to go down does not keep loop() busy.
+ */
+
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+static int penDowns = 0;
+static uint32_t msPenDown = 0;
+static void onPenDown(const TouchEvent &ev) { (void)ev; penDowns++; msPenDown = millis(); }
+
+
+int main()
+{
+    host::useVirtualTime();
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+    XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    sim.attachPins();
+    touchpad.begin();
+    touchpad.useIrq(TP_IRQ);
+    touchpad.addPenDownCb(onPenDown);
+
+    // pen up: loop() sleeps in waitForTouch() and never talks to the controller
+    host::resetPinCounters();
+    uint32_t ms = millis();
+    int loops = 0;
+    while (millis() - ms < 2000) 
+    {
+        touchpad.loop();
+        loops++;
+    }
+    CHECK_EQ(sim.conversions(), 0);
+    CHECK_EQ(host::pinWrites(TP_SCLK), 0);
+    CHECK(loops <= 2000 / XPT2046_LATENCY_BUDGET_MS + 1);
+    CHECK(touchpad.getIdleCpuPercent() >= 99);
+    CHECK(! touchpad.getTouch());
+
+    // waitForTouch() returns on the falling edge, not at the timeout
+    sim.play({{30, true, 2000, 2000, 400}});
+    ms = millis();
+    CHECK(touchpad.waitForTouch(1000));
+    CHECK_NEAR(millis() - ms, 30, 2);
+    CHECK(touchpad.getTouch());
+    sim.release();
+    ms = millis();
+    CHECK(! touchpad.waitForTouch(50));
+    CHECK_NEAR(millis() - ms, 50, 2);
+
+    // a tap is detected without polling delay and sampled while the pen is down
+    sim.resetCounters();
+    sim.play({{  530, true,  2000, 2000, 400},
+              {  730, false,    0,    0,   0}});
+    ms = millis();
+    while (millis() - ms < 1500) touchpad.loop();
+    msPenDown -= ms;
+    CHECK_EQ(penDowns, 1);
+    CHECK(msPenDown >= 530 && msPenDown <= 532);
+    uint32_t samples = sim.conversions(XPT2046Sim::CH_Z1);
+    CHECK(samples >= 200 / XPT2046_ACTIVE_PERIOD_MS - 2 && samples <= 200 / XPT2046_ACTIVE_PERIOD_MS + 2);
+    printf("idle loops %d, tap of 200 ms: %u samples, pen down reported after %u ms\n", 
+           loops, (unsigned)samples, (unsigned)(msPenDown - 530));
+
+    // a light touch after the pen was lifted (PENIRQ high, no pressure
+    // measured) must not inherit the release threshold of the firm one
+    sim.touch(2000, 2000, 400);
+    CHECK(touchpad.getTouch());
+    sim.release();
+    CHECK(! touchpad.getTouch());
+    sim.touch(2000, 2000, (XPT2046_R_PEN_DOWN + XPT2046_R_PEN_UP) / 2);
+    CHECK(! touchpad.getTouch());
+
+    // PENIRQ is low during the light touch, loop() must still back off
+    sim.resetCounters();
+    ms = millis();
+    loops = 0;
+    while (millis() - ms < 1000)
+    {
+        touchpad.loop();
+        loops++;
+    }
+    CHECK_EQ(penDowns, 1);
+    CHECK(loops <= 1000 / XPT2046_LATENCY_BUDGET_MS + 8);
+    CHECK(touchpad.getIdleCpuPercent() >= 90);
+    printf("light touch with PENIRQ low: %d loops in 1 s\n", loops);
+    sim.release();
+    return testResult("irq_sim_test");
+}
@@ -0,0 +1,80 @@
+/**
+ * File         metrics_test.cpp
+ *
+ * Purpose      Counters of the driver built with XPT2046_METRICS=1 (see
+ *              XPT2046_Metrics.h). Samples with the pen lifted, a touch too 
+ *              light and a tap are driven through the simulated controller,
+ *              the samples, rejections, events, handlers and the histogram 
+ *              of cycles must count them. printMetrics() is run once.
+ */
+
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+
+static int taps = 0;
+static void onTap(void *ctx, const TouchEvent &ev) { (void)ctx; (void)ev; taps++; }
+
+
+int main()
+{
+    static_assert(XPT2046_METRICS, "build with -D XPT2046_METRICS=1");
+    host::useVirtualTime();
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    touchpad.subscribe(TOUCH_SHORT, onTap);
+    touchpad.subscribe(TOUCH_SHORT, onTap);
+    const TouchMetrics &m = touchpad.getMetrics();
+    TouchPoint tp;
+
+    // pen lifted, no contact after Z1
+    for (int i = 0; i < 5; i++) CHECK(! touchpad.getTouch(tp));
+    CHECK_EQ(m.samples, 5);
+    CHECK_EQ(m.rejectedZ1, 5);
+    CHECK_EQ(m.rejectedPressure, 0);
+
+    // too light for the pen to go down
+    sim.touch(2000, 2000, (XPT2046_R_PEN_DOWN + XPT2046_R_PEN_UP) / 2);
+    for (int i = 0; i < 3; i++) CHECK(! touchpad.getTouch(tp));
+    CHECK_EQ(m.samples, 8);
+    CHECK_EQ(m.rejectedPressure, 3);
+
+    // pressed
+    sim.touch(2000, 2000, 400);
+    for (int i = 0; i < 4; i++) CHECK(touchpad.getTouch(tp));
+    CHECK_EQ(m.samples, 12);
+    CHECK_EQ(m.rejectedZ1 + m.rejectedPressure, 8);
+    sim.release();
+    touchpad.getTouch(tp);
+
+    // a tap through loop()
+    uint32_t samples = m.samples;
+    sim.play({{ 50, true, 2000, 2000, 400},
+              {150, true, 2000, 2000, 400},
+              {151, false,   0,    0,   0}});
+    uint32_t ms = millis();
+    int loops = 0;
+    while (millis() - ms < 300)
+    {
+        touchpad.loop();
+        loops++;
+    }
+    CHECK_EQ(m.loops, loops);
+    CHECK(m.samples > samples);
+    CHECK_EQ(taps, 2);
+    CHECK_EQ(m.events[TOUCH_SHORT], 1);
+    CHECK_EQ(m.events[TOUCH_PEN_DOWN], 1);
+    CHECK_EQ(m.events[TOUCH_PEN_UP], 1);
+    CHECK_EQ(m.handlers, 2);          // the two handlers of the short touch
+
+    uint32_t histogram = 0;
+    for (uint32_t n : m.cycles) histogram += n;
+    CHECK_EQ(histogram, m.samples);
+    CHECK(m.busCycles > 0);
+    touchpad.printMetrics();
+    return testResult("metrics_test");
+}
@@ -0,0 +1,334 @@
+/**
+ * File         record_test.cpp
+ *
+ * Purpose      Screen recording of recordScreenToSD.cpp against the simulated
+ *              panel and SD card. Frames with known changes are recorded, the
+ *              file is decoded by the layout documented in the source: the
+ *              header, the tiles of each frame, clipped at the right and the
+ *              bottom edge, the keyframes, the index and the trailer. Every
+ *              frame restored from the tiles must be the screen at the time
+ *              it was recorded, also when the recording without index is
+ *              scanned frame by frame. If python3 was found, tools/cydrec.py
+ *              must give the same frames as BMP files.
+ *
+ *              Built with RECORD_TILE_SIZE 28, the tiles do not divide the
+ *              screen, and RECORD_KEYFRAME_INTERVAL 4.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "Host.h"
+#include <SD.h>
+#include "lgfx_ESP32_2432S028.h"
+
+extern bool startRecording(LGFX &lcd, const char *filename);
+extern bool recordFrame(LGFX &lcd);
+extern bool stopRecording();
+
+static LGFX lcd;
+
+using Frame = struct frm
+{
+    uint32_t offset;
+    bool     key;
+    uint32_t ms;
+    std::vector<int> tiles;
+    std::vector<uint8_t> screen;   // b,g,r rows top down after the frame
+};
+
+using Recording = struct rcd
+{
+    int      width, height, tile, tilesX;
+    bool     indexed;
+    uint32_t indexOffset;
+    std::vector<Frame> frames;
+};
+
+static uint16_t get16(const uint8_t *p) { return p[0] | p[1] << 8; }
+static uint32_t get32(const uint8_t *p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+
+
+/**
+ * Reads the frame at offset and draws its tiles over screen,
+ * returns the offset after the frame, 0 if it is incomplete
+ */
+static uint32_t readFrame(const std::vector<uint8_t> &data, const Recording &rec, uint32_t offset,
+                          Frame &frame, std::vector<uint8_t> &screen)
+{
+    if (offset + 8 > data.size() || data[offset] != 'F') return 0;
+    frame.offset = offset;
+    frame.key = data[offset + 1] & 1;
+    frame.ms = get32(&data[offset + 4]);
+    frame.tiles.clear();
+    offset += 8;
+    for (;;)
+    {
+        if (offset + 2 > data.size()) return 0;
+        int n = get16(&data[offset]);
+        offset += 2;
+        if (n == 0xFFFF) break;
+        int x = n % rec.tilesX * rec.tile, y = n / rec.tilesX * rec.tile;
+        int w = std::min(rec.tile, rec.width - x), h = std::min(rec.tile, rec.height - y);
+        if (y >= rec.height || offset + 3 * w * h > data.size()) return 0;
+        for (int r = 0; r < h; r++, offset += 3 * w)
+            memcpy(&screen[3 * ((y + r) * rec.width + x)], &data[offset], 3 * w);
+        frame.tiles.push_back(n);
+    }
+    frame.screen = screen;
+    return offset;
+}
+
+
+/**
+ * Decodes the recording, through the index if there is one,
+ * frame by frame from the header otherwise
+ */
+static bool decode(const std::vector<uint8_t> &data, Recording &rec)
+{
+    if (data.size() < 16 || memcmp(data.data(), "CYDR", 4) || data[4] != 1 || data[5] != 16 || data[11] != 3)
+        return false;
+    rec.width  = get16(&data[6]);
+    rec.height = get16(&data[8]);
+    rec.tile   = data[10];
+    rec.tilesX = (rec.width + rec.tile - 1) / rec.tile;
+    rec.frames.clear();
+
+    std::vector<uint32_t> offsets;
+    size_t size = data.size();
+    rec.indexed = size >= 8 && ! memcmp(&data[size - 4], "CYDX", 4);
+    if (rec.indexed)
+    {
+        rec.indexOffset = get32(&data[size - 8]);
+        if (rec.indexOffset + 8 > size || data[rec.indexOffset] != 'I') return false;
+        uint32_t count = get32(&data[rec.indexOffset + 4]);
+        if (rec.indexOffset + 8 + 4 * count + 8 != size) return false;
+        for (uint32_t i = 0; i < count; i++) offsets.push_back(get32(&data[rec.indexOffset + 8 + 4 * i]));
+    }
+
+    std::vector<uint8_t> screen(3 * rec.width * rec.height);
+    uint32_t offset = 16;
+    for (size_t i = 0; ! rec.indexed || i < offsets.size(); i++)
+    {
+        if (rec.indexed && offsets[i] != offset) return false;  // the frames follow each other
+        Frame frame;
+        uint32_t end = readFrame(data, rec, offset, frame, screen);
+        if (! end)
+        {
+            if (rec.indexed) return false;
+            break;  // the last frame is incomplete
+        }
+        rec.frames.push_back(frame);
+        offset = end;
+    }
+    return ! rec.indexed || offset == rec.indexOffset;
+}
+
+
+// the screen as b,g,r rows top down like the tiles
+static std::vector<uint8_t> snapshot()
+{
+    std::vector<uint8_t> screen;
+    for (int y = 0; y < lcd.height(); y++)
+        for (int x = 0; x < lcd.width(); x++)
+        {
+            uint32_t c = lcd.pixel888(x, y);
+            screen.push_back(c);
+            screen.push_back(c >> 8);
+            screen.push_back(c >> 16);
+        }
+    return screen;
+}
+
+
+static void stripes()
+{
+    for (int x = 0; x < lcd.width(); x += 10) lcd.fillRect(x, 0, 10, lcd.height(), x * 0x0841 + 0x1234);
+}
+
+
+/**
+ * Frames with known changes in landscape, the bottom row and the
+ * right column of tiles are clipped to 240 - 8 * 28 = 16 rows and
+ * 320 - 11 * 28 = 12 columns
+ */
+static std::vector<std::vector<uint8_t>> testLandscape()
+{
+    std::vector<std::vector<uint8_t>> shots;
+    lcd.setRotation(0);  // 320 x 240 in the stand-in
+    stripes();
+    CHECK(startRecording(lcd, "/rec.cdr"));                                            // 0, keyframe
+    shots.push_back(snapshot());
+    delay(100); CHECK(recordFrame(lcd));                                               // 1, no change
+    shots.push_back(snapshot());
+    lcd.setPixel888(319, 239, 0xFF0000);
+    delay(100); CHECK(recordFrame(lcd));                                               // 2, the corner tile
+    shots.push_back(snapshot());
+    lcd.fillRect(20, 0, 20, 10, TFT_WHITE);
+    delay(100); CHECK(recordFrame(lcd));                                               // 3, two tiles
+    shots.push_back(snapshot());
+    delay(100); CHECK(recordFrame(lcd));                                               // 4, keyframe
+    shots.push_back(snapshot());
+    lcd.setPixel888(0, 239, 0x00FF00);
+    lcd.setPixel888(300, 100, 0x0000FF);
+    delay(100); CHECK(recordFrame(lcd));                                               // 5, two tiles
+    shots.push_back(snapshot());
+    CHECK(stopRecording());
+    CHECK(! recordFrame(lcd));
+    CHECK(! stopRecording());
+
+    std::vector<uint8_t> data = host::fileData("/rec.cdr");
+    Recording rec;
+    CHECK(decode(data, rec));
+    CHECK(rec.indexed);
+    CHECK_EQ(rec.width, 320);
+    CHECK_EQ(rec.height, 240);
+    CHECK_EQ(rec.tile, 28);
+    CHECK_EQ(rec.tilesX, 12);
+    CHECK_EQ(rec.frames.size(), shots.size());
+
+    std::vector<std::vector<int>> tiles = {{}, {}, {8 * 12 + 11}, {0, 1}, {}, {3 * 12 + 10, 8 * 12}};
+    for (size_t i = 0; i < rec.frames.size() && i < shots.size(); i++)
+    {
+        const Frame &f = rec.frames[i];
+        CHECK_EQ(f.key, i % 4 == 0);
+        CHECK_EQ(f.ms, 100 * i);
+        if (f.key) CHECK_EQ(f.tiles.size(), 12 * 9);
+        else CHECK(f.tiles == tiles[i]);
+        CHECK(f.screen == shots[i]);
+    }
+    // the corner tile is 12 x 16 pixels
+    if (rec.frames.size() > 3) CHECK_EQ(rec.frames[3].offset - rec.frames[2].offset, 8 + 2 + 3 * 12 * 16 + 2);
+
+    // without index, e.g. after a reset, and with the last frame cut short
+    std::vector<uint8_t> noIndex(data.begin(), data.begin() + rec.indexOffset);
+    Recording scanned;
+    CHECK(decode(noIndex, scanned));
+    CHECK(! scanned.indexed);
+    CHECK_EQ(scanned.frames.size(), shots.size());
+    for (size_t i = 0; i < scanned.frames.size(); i++) CHECK(scanned.frames[i].screen == shots[i]);
+    noIndex.resize(noIndex.size() - 5);
+    CHECK(decode(noIndex, scanned));
+    CHECK_EQ(scanned.frames.size(), shots.size() - 1);
+    return shots;
+}
+
+
+/**
+ * Portrait, the tiles are clipped at the other edges, and a change
+ * of the rotation during the recording
+ */
+static void testPortrait()
+{
+    lcd.setRotation(1);
+    stripes();
+    CHECK(startRecording(lcd, "/portrait.cdr"));
+    std::vector<uint8_t> shot = snapshot();
+    CHECK(! startRecording(lcd, "/other.cdr"));
+    lcd.setRotation(0);
+    CHECK(! recordFrame(lcd));
+    lcd.setRotation(1);
+    CHECK(stopRecording());
+
+    Recording rec;
+    CHECK(decode(host::fileData("/portrait.cdr"), rec));
+    CHECK_EQ(rec.width, 240);
+    CHECK_EQ(rec.height, 320);
+    CHECK_EQ(rec.frames.size(), 1);
+    if (rec.frames.size() == 1)
+    {
+        CHECK_EQ(rec.frames[0].tiles.size(), 9 * 12);
+        CHECK(rec.frames[0].screen == shot);
+    }
+}
+
+
+// 24-bit BMP as written by cydrec.py, rows padded to 4 bytes
+static std::vector<uint8_t> bmp24(const std::vector<uint8_t> &screen, int width, int height)
+{
+    int line = 3 * width, rowSize = (line + 3) & ~3;
+    lgfx::bitmap_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.bfType = 0x4D42;
+    h.bfSize = rowSize * height + sizeof(h);
+    h.bfOffBits = sizeof(h);
+    h.biSize = 40;
+    h.biWidth = width;
+    h.biHeight = height;
+    h.biPlanes = 1;
+    h.biBitCount = 24;
+    h.biSizeImage = rowSize * height;
+    std::vector<uint8_t> bmp((const uint8_t *)&h, (const uint8_t *)&h + sizeof(h));
+    for (int y = height - 1; y >= 0; y--)
+    {
+        bmp.insert(bmp.end(), screen.begin() + y * line, screen.begin() + (y + 1) * line);
+        bmp.resize(bmp.size() + rowSize - line, 0);
+    }
+    return bmp;
+}
+
+
+static void writeFile(const std::string &path, const std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    CHECK(f);
+    if (! f) return;
+    CHECK_EQ(fwrite(data.data(), 1, data.size(), f), data.size());
+    fclose(f);
+}
+
+
+static std::vector<uint8_t> readFile(const std::string &path)
+{
+    std::vector<uint8_t> data;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (! f) return data;
+    int c;
+    while ((c = fgetc(f)) != EOF) data.push_back(c);
+    fclose(f);
+    return data;
+}
+
+
+/**
+ * tools/cydrec.py on the recording with and without index
+ */
+static void testCydrec(const std::vector<std::vector<uint8_t>> &shots)
+{
+#ifdef PYTHON
+    std::vector<uint8_t> data = host::fileData("/rec.cdr");
+    Recording rec;
+    CHECK(decode(data, rec));
+    writeFile("record_test.cdr", data);
+    writeFile("record_test_noindex.cdr", std::vector<uint8_t>(data.begin(), data.begin() + rec.indexOffset));
+
+    std::string run = std::string(PYTHON) + " " + CYDREC + " ";
+    CHECK_EQ(system((run + "record_test.cdr record_test_frames > /dev/null").c_str()), 0);
+    for (size_t i = 0; i < shots.size(); i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "record_test_frames/frame%05u.bmp", (unsigned)i);
+        CHECK(readFile(path) == bmp24(shots[i], 320, 240));
+    }
+    // frame 5 restored from the keyframe 4, found by the scan
+    CHECK_EQ(system((run + "record_test_noindex.cdr record_test_frame5 --frame 5 > /dev/null").c_str()), 0);
+    CHECK(readFile("record_test_frame5/frame00005.bmp") == bmp24(shots[5], 320, 240));
+    CHECK(readFile("record_test_frame5/frame00004.bmp").empty());
+#else
+    (void)shots;
+    printf("python3 not found, tools/cydrec.py is not tested\n");
+#endif
+}
+
+
+int main()
+{
+    host::useVirtualTime();
+    std::vector<std::vector<uint8_t>> shots = testLandscape();
+    testPortrait();
+    testCydrec(shots);
+    return testResult("record_test");
+}
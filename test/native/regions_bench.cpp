@@ -0,0 +1,139 @@
+/**
+ * File         regions_bench.cpp
+ *
+ * Purpose      Hit test of TouchRegions (XPT2046_Regions.h) with 10, 100 and
+ *              1000 regions, as a grid of keys that do not overlap and as
+ *              buttons of random size, position and z that do. The result of
+ *              every lookup is compared with a linear scan over all regions,
+ *              like the former chain of touchedAt() calls, whose time is
+ *              given for comparison. Built with XPT2046_MAX_REGIONS=1000.
+ */
+
+#include <stdlib.h>
+#include <vector>
+#include "check.h"
+#include "XPT2046_Regions.h"
+
+#define WIDTH   320
+#define HEIGHT  240
+#define NBR_LOOKUPS 200000
+
+using Rect = struct rect { int x, y, w, h, z, id; };
+
+
+// topmost region at x, y by a linear scan, later regions win for equal z
+static int linearHitTest(const std::vector<Rect> &rects, int x, int y)
+{
+    int hit = -1, z = -1;
+    for (const Rect &r : rects)
+    {
+        if (x >= r.x && y >= r.y && x < r.x + r.w && y < r.y + r.h && r.z >= z)
+        {
+            hit = r.id;
+            z = r.z;
+        }
+    }
+    return hit;
+}
+
+
+static double run(const char *layout, std::vector<Rect> rects)
+{
+    static TouchRegions regions;   // too large for the stack with 1000 regions
+    regions.clear();
+    for (Rect &r : rects)
+    {
+        r.id = regions.add(r.x, r.y, r.w, r.h, nullptr, nullptr, r.z);
+        CHECK(r.id >= 0);
+    }
+
+    std::vector<int> px(4096), py(4096);
+    for (size_t i = 0; i < px.size(); i++)
+    {
+        px[i] = rand() % WIDTH;
+        py[i] = rand() % HEIGHT;
+        CHECK_EQ(regions.hitTest(px[i], py[i]), linearHitTest(rects, px[i], py[i]));
+    }
+
+    int hits = 0;
+    uint64_t ns = wallNanos();
+    for (int i = 0; i < NBR_LOOKUPS; i++) hits += regions.hitTest(px[i & 4095], py[i & 4095]) >= 0;
+    double nsGrid = (double)(wallNanos() - ns) / NBR_LOOKUPS;
+    keep(hits);
+    ns = wallNanos();
+    for (int i = 0; i < NBR_LOOKUPS / 10; i++) hits += linearHitTest(rects, px[i & 4095], py[i & 4095]) >= 0;
+    double nsLinear = (double)(wallNanos() - ns) / (NBR_LOOKUPS / 10);
+    keep(hits);
+    printf("%-7s %4u regions  grid %6.1f ns/lookup  linear scan %7.1f ns/lookup\n",
+           layout, (unsigned)rects.size(), nsGrid, nsLinear);
+    return nsGrid / nsLinear;
+}
+
+
+// n keys of equal size covering the screen
+static std::vector<Rect> keys(int n)
+{
+    int cols = 1;
+    while (cols * cols * HEIGHT < n * WIDTH) cols++;
+    int rows = (n + cols - 1) / cols;
+    std::vector<Rect> rects;
+    for (int i = 0; i < n; i++)
+    {
+        rects.push_back(Rect {i % cols * WIDTH / cols, i / cols * HEIGHT / rows, WIDTH / cols, HEIGHT / rows, 0, -1});
+    }
+    return rects;
+}
+
+
+// n buttons of 8..48 pixels at random places with 4 levels of z
+static std::vector<Rect> buttons(int n)
+{
+    std::vector<Rect> rects;
+    for (int i = 0; i < n; i++)
+    {
+        int w = 8 + rand() % 41, h = 8 + rand() % 41;
+        rects.push_back(Rect {rand() % (WIDTH - w), rand() % (HEIGHT - h), w, h, rand() % 4, -1});
+    }
+    return rects;
+}
+
+
+int main()
+{
+    srand(320240);
+    double keys1000, buttons1000;
+    for (int n : {10, 100, 1000}) keys1000 = run("keys", keys(n));
+    for (int n : {10, 100, 1000}) buttons1000 = run("buttons", buttons(n));
+    // the grid only walks the regions of one cell
+    CHECK(keys1000 < 0.2 && buttons1000 < 0.2);
+
+    // z order, removal and reuse of the id
+    static TouchRegions regions;
+    regions.clear();
+    int a = regions.add(0, 0, 100, 100);
+    int b = regions.add(50, 50, 100, 100);
+    int c = regions.add(60, 60, 10, 10, nullptr, nullptr, 0);
+    int d = regions.add(0, 0, 30, 30, nullptr, nullptr, 1);
+    int e = regions.add(0, 0, 320, 240, nullptr, nullptr, 0);
+    CHECK_EQ(regions.hitTest(60, 60), e);
+    CHECK(regions.remove(e));
+    CHECK(! regions.remove(e));
+    CHECK_EQ(regions.hitTest(60, 60), c);
+    CHECK_EQ(regions.hitTest(75, 75), b);
+    CHECK_EQ(regions.hitTest(10, 10), d);
+    CHECK_EQ(regions.hitTest(40, 10), a);
+    CHECK_EQ(regions.hitTest(200, 200), -1);
+    CHECK_EQ(regions.add(0, 0, 0, 10), -1);
+    CHECK_EQ(regions.add(200, 200, 10, 10), e);
+
+    // more regions than the pool of cell entries can hold
+    regions.clear();
+    int added = 0;
+    while (regions.add(0, 0, WIDTH, HEIGHT) >= 0) added++;
+    const int cells = ((WIDTH + XPT2046_REGION_CELL - 1) / XPT2046_REGION_CELL) * ((HEIGHT + XPT2046_REGION_CELL - 1) / XPT2046_REGION_CELL);
+    CHECK_EQ(added, XPT2046_REGION_ENTRIES / cells);
+    CHECK_EQ(regions.hitTest(100, 100), added - 1);
+    CHECK(regions.remove(7));
+    CHECK_EQ(regions.add(0, 0, 10, 10), 7);
+    return testResult("regions_bench");
+}
@@ -0,0 +1,119 @@
+/**
+ * File         rotation_bench.cpp
+ *
+ * Purpose      Mapping of the raw values to screen coordinates in all four
+ *              rotations: the former two map() calls, the clamp and the
+ *              switch on the rotation against the fixed point transform with
+ *              the rotation folded in (rotateAffineTransform()). Both are
+ *              fed with a 2 point calibration, so they must agree within
+ *              the rounding of map().
+ */
+
+#include <algorithm>
+#include <vector>
+#include "check.h"
+#include "XPT2046_Calibration.h"
+
+#define WIDTH   320
+#define HEIGHT  240
+#define NBR_SAMPLES 1000000
+
+namespace legacy
+{
+// the calibration and mapping of the former getTouch()
+struct Calibration { TouchPoint touchMin, touchMax; };
+
+static long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+__attribute__((noinline))
+static void mapToScreen(const Calibration &cal, uint8_t rotation, TouchPoint &tp)
+{
+    int x = map(tp.xValue, cal.touchMin.xValue, cal.touchMax.xValue, cal.touchMin.x, cal.touchMax.x);
+    int y = map(tp.yValue, cal.touchMin.yValue, cal.touchMax.yValue, cal.touchMin.y, cal.touchMax.y);
+    x = x < 0 ? 0 : x;
+    x = x > WIDTH ? WIDTH : x;
+    y = y < 0 ? 0 : y;
+    y = y > HEIGHT ? HEIGHT : y;
+    switch (rotation)
+    {
+        case 0: tp.x = x;          tp.y = y;          break;
+        case 1: tp.x = y;          tp.y = WIDTH - x;  break;
+        case 2: tp.x = WIDTH - x;  tp.y = HEIGHT - y; break;
+        case 3: tp.x = HEIGHT - y; tp.y = x;          break;
+    }
+}
+}
+
+
+// as XPT2046_Bitbang::_mapToScreen()
+__attribute__((noinline))
+static void mapToScreen(const AffineTransform &xform, int xMax, int yMax, TouchPoint &tp)
+{
+    int x, y;
+    applyAffineTransform(xform, tp.xValue, tp.yValue, x, y);
+    tp.x = std::min(std::max(x, 0), xMax);
+    tp.y = std::min(std::max(y, 0), yMax);
+}
+
+
+int main()
+{
+    TouchCalibration cal = {};
+    cal.nbrPoints = 2;
+    cal.point[0] = TouchPoint { 20, 20, 510, 630, 0, 0 };
+    cal.point[1] = TouchPoint { 300, 220, 3730, 3580, 0, 0 };
+    legacy::Calibration oldCal = { cal.point[0], cal.point[1] };
+    AffineTransform t;
+    CHECK(fitAffineTransform(cal, t));
+
+    std::vector<TouchPoint> raw(4096);
+    srand(2025);
+    for (TouchPoint &tp : raw) tp = TouchPoint { 0, 0, 200 + rand() % 3700, 200 + rand() % 3700, 0, 0 };
+
+    double nsOld[4], nsNew[4];
+    for (uint8_t r = 0; r < 4; r++)
+    {
+        AffineTransform xform = rotateAffineTransform(t, r, WIDTH, HEIGHT);
+        int xMax = (r & 1) ? HEIGHT : WIDTH;
+        int yMax = (r & 1) ? WIDTH  : HEIGHT;
+
+        int maxDiff = 0;
+        for (TouchPoint a : raw)
+        {
+            TouchPoint b = a;
+            legacy::mapToScreen(oldCal, r, a);
+            mapToScreen(xform, xMax, yMax, b);
+            maxDiff = std::max(maxDiff, std::max(abs(a.x - b.x), abs(a.y - b.y)));
+        }
+        CHECK(maxDiff <= 1);
+
+        TouchPoint tp;
+        uint64_t ns = wallNanos();
+        for (int i = 0; i < NBR_SAMPLES; i++)
+        {
+            tp = raw[i & 4095];
+            legacy::mapToScreen(oldCal, r, tp);
+            keep(tp);
+        }
+        nsOld[r] = (double)(wallNanos() - ns) / NBR_SAMPLES;
+        ns = wallNanos();
+        for (int i = 0; i < NBR_SAMPLES; i++)
+        {
+            tp = raw[i & 4095];
+            mapToScreen(xform, xMax, yMax, tp);
+            keep(tp);
+        }
+        nsNew[r] = (double)(wallNanos() - ns) / NBR_SAMPLES;
+        printf("rotation %d  map() + switch %5.2f ns/sample  folded transform %5.2f ns/sample  max difference %d px\n",
+               r, nsOld[r], nsNew[r], maxDiff);
+    }
+
+    // the transform costs the same in every rotation and no more than map()
+    double nsMin = *std::min_element(nsNew, nsNew + 4), nsMax = *std::max_element(nsNew, nsNew + 4);
+    CHECK(nsMax < 1.5 * nsMin + 1);
+    for (int r = 0; r < 4; r++) CHECK(nsNew[r] < 1.2 * nsOld[r] + 1);
+    return testResult("rotation_bench");
+}
@@ -0,0 +1,369 @@
+/**
+ * File         screenshot_bench.cpp
+ *
+ * Purpose      Screenshots of saveBMPtoSD.cpp against the simulated panel and
+ *              SD card. The 24-bit BMP must be byte for byte the file of the
+ *              former row at a time routine and of a reference built from the
+ *              framebuffer, with one row, a band that does not divide the
+ *              height and the default band, in both orientations. The 16-bit
+ *              BMP is decoded through its masks. Every write to the SD card
+ *              but the last is whole sectors. The time and the number of panel
+ *              reads and SD writes are given for the former routine and the
+ *              bands. A task notification pending for the caller, e.g. from
+ *              PENIRQ, is still there after a screenshot. The stand-ins have
+ *              no bus time, on the host the bands only add the handover to
+ *              the writer task, on the CYD the panel reads and SD writes they
+ *              save dominate. The RLE8 BMP of grid(), framedCrosshair() and a
+ *              screen of 200 colors is decoded and compared pixel by pixel,
+ *              its size and time are given against the 24-bit BMP. A screen
+ *              of more than 256 colors is saved as 24-bit BMP. The stand-in
+ *              draws no text, on the CYD the labels add colors and runs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "Host.h"
+#include <SD.h>
+#include "lgfx_ESP32_2432S028.h"
+
+#define NBR_SHOTS 20
+
+extern bool saveBMPtoSD_16bit(LGFX &lcd, const char *filename);
+extern bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename);
+extern bool saveBMPtoSD_rle8(LGFX &lcd, const char *filename);
+extern void grid(LGFX &lcd);
+extern void framedCrosshair(LGFX &lcd);
+
+static LGFX lcd;
+
+
+/**
+ * The former routine, one readRect() and one write per row
+ * and the colors rotated pixel by pixel
+ */
+namespace legacy
+{
+    void rotate_rgb888(lgfx::rgb888_t* buf, int bufSize)
+    {
+        auto  rotateTriple = [](lgfx::rgb888_t* pRGB)
+              {
+                lgfx::rgb888_t tmp = *pRGB;
+                pRGB->r = tmp.g;
+                pRGB->g = tmp.b;
+                pRGB->b = tmp.r;
+              };
+        int nTriples = bufSize / 3;
+        for (int i = 0; i < nTriples; i++)
+        {
+            rotateTriple(buf);
+            buf++;
+        }
+    }
+
+    bool saveBMPtoSD_24bit(LGFX &lcd, const char *filename)
+    {
+        File file = SD.open(filename, "w");
+        if (! file) return false;
+        int width   = lcd.width();
+        int height  = lcd.height();
+        int rowSize = (3 * width + 3) & ~ 3;
+
+        lgfx::bitmap_header_t bmpheader;
+        memset(&bmpheader, 0, sizeof(bmpheader));   // the fields not set were undefined
+        bmpheader.bfType = 0x4D42;
+        bmpheader.bfSize = rowSize * height + sizeof(bmpheader);
+        bmpheader.bfOffBits = sizeof(bmpheader);
+        bmpheader.biSize = 40;
+        bmpheader.biWidth = width;
+        bmpheader.biHeight = height;
+        bmpheader.biPlanes = 1;
+        bmpheader.biBitCount = 24;
+        bmpheader.biCompression = 0;
+
+        file.write((std::uint8_t*)&bmpheader, sizeof(bmpheader));
+        std::vector<uint8_t> buffer(rowSize);
+        for (int y = lcd.height() - 1; y >= 0; y--)
+        {
+            lcd.readRect(0, y, lcd.width(), 1, (lgfx::rgb888_t*)buffer.data());
+            rotate_rgb888((lgfx::rgb888_t*)buffer.data(), rowSize);
+            file.write(buffer.data(), rowSize);
+        }
+        file.close();
+        return true;
+    }
+}
+
+
+// 24-bit BMP of the framebuffer: bottom up, b, g, r, rows padded to 4 bytes
+static std::vector<uint8_t> reference24()
+{
+    int width = lcd.width(), height = lcd.height();
+    int rowSize = (3 * width + 3) & ~3;
+    lgfx::bitmap_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.bfType = 0x4D42;
+    h.bfSize = rowSize * height + sizeof(h);
+    h.bfOffBits = sizeof(h);
+    h.biSize = 40;
+    h.biWidth = width;
+    h.biHeight = height;
+    h.biPlanes = 1;
+    h.biBitCount = 24;
+    std::vector<uint8_t> bmp((const uint8_t *)&h, (const uint8_t *)&h + sizeof(h));
+    for (int y = height - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t c = lcd.pixel888(x, y);
+            bmp.push_back(c);
+            bmp.push_back(c >> 8);
+            bmp.push_back(c >> 16);
+        }
+        bmp.resize(bmp.size() + rowSize - 3 * width, 0);
+    }
+    return bmp;
+}
+
+
+static void randomScreen()
+{
+    for (int y = 0; y < lcd.height(); y++)
+        for (int x = 0; x < lcd.width(); x++) lcd.setPixel888(x, y, (rand() << 8 ^ rand()) & 0xFFFFFF);
+}
+
+
+// all writes but the last start and end at a sector boundary
+static bool sectorAligned(const char *path)
+{
+    std::vector<host::FileWrite> writes = host::fileWrites(path);
+    for (size_t i = 0; i + 1 < writes.size(); i++)
+    {
+        if (writes[i].offset % 512 || writes[i].size % 512) return false;
+    }
+    return true;
+}
+
+
+/**
+ * Largest free block for bands of the given rows in both buffers,
+ * 0 for the default
+ */
+static void bandRows(int rows)
+{
+    int rowSize = (3 * lcd.width() + 3) & ~3;
+    host::setLargestFreeBlock(rows ? 2 * rows * rowSize : 110000);
+}
+
+
+static void testFiles()
+{
+    for (int rotation : {1, 0})
+    {
+        lcd.setRotation(rotation);
+        randomScreen();
+        std::vector<uint8_t> ref = reference24();
+        CHECK(legacy::saveBMPtoSD_24bit(lcd, "/legacy.bmp"));
+        CHECK(host::fileData("/legacy.bmp") == ref);
+
+        for (int rows : {1, 7, 0})
+        {
+            bandRows(rows);
+            CHECK(saveBMPtoSD_24bit(lcd, "/shot24.bmp"));
+            CHECK(host::fileData("/shot24.bmp") == ref);
+            CHECK(sectorAligned("/shot24.bmp"));
+
+            CHECK(saveBMPtoSD_16bit(lcd, "/shot16.bmp"));
+            CHECK(sectorAligned("/shot16.bmp"));
+            std::vector<uint8_t> bmp = host::fileData("/shot16.bmp");
+            const lgfx::bitmap_header_t *h = (const lgfx::bitmap_header_t *)bmp.data();
+            CHECK_EQ(bmp.size(), h->bfSize);
+            CHECK_EQ(h->biWidth, lcd.width());
+            CHECK_EQ(h->biHeight, lcd.height());
+            CHECK_EQ(h->biCompression, 3);
+            uint32_t masks[3];
+            memcpy(masks, bmp.data() + sizeof(*h), sizeof(masks));
+            CHECK(masks[0] == 0xFC00 && masks[1] == 0x03E0 && masks[2] == 0x001F);
+
+            int rowSize = (2 * lcd.width() + 3) & ~3, wrong = 0;
+            for (int y = 0; y < lcd.height(); y++)
+                for (int x = 0; x < lcd.width(); x++)
+                {
+                    const uint8_t *p = bmp.data() + h->bfOffBits + (lcd.height() - 1 - y) * rowSize + 2 * x;
+                    uint32_t v = p[0] | p[1] << 8, c = lcd.pixel888(x, y);
+                    wrong += (v >> 10) != (c >> 18) || ((v >> 5) & 0x1F) != ((c >> 11) & 0x1F) || (v & 0x1F) != ((c >> 3) & 0x1F);
+                }
+            CHECK_EQ(wrong, 0);
+        }
+    }
+    bandRows(0);
+}
+
+
+static void bench(const char *name, bool (*save)(LGFX &, const char *))
+{
+    uint32_t reads = lcd.readRects();
+    uint64_t ns = wallNanos();
+    for (int i = 0; i < NBR_SHOTS; i++) CHECK(save(lcd, "/bench.bmp"));
+    double ms = (double)(wallNanos() - ns) / NBR_SHOTS / 1e6;
+    printf("%-16s %6.2f ms/shot  %3u panel reads  %3u SD writes\n", name, ms,
+           (unsigned)((lcd.readRects() - reads) / NBR_SHOTS), (unsigned)host::fileWrites("/bench.bmp").size());
+}
+
+
+/**
+ * The writer task must not end the screenshot through the
+ * notification of the caller, nor take it away
+ */
+static void testPendingNotification()
+{
+    for (int rows : {1, 0})
+    {
+        bandRows(rows);
+        xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+        CHECK(saveBMPtoSD_24bit(lcd, "/notify.bmp"));
+        CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+        CHECK(host::fileData("/notify.bmp") == reference24());
+    }
+    bandRows(0);
+}
+
+
+/**
+ * Decodes the BI_RLE8 file into colors 0xRRGGBB, top row first,
+ * empty if the file is not a valid RLE8 BMP of the screen
+ */
+static std::vector<uint32_t> decodeRLE8(const std::vector<uint8_t> &bmp)
+{
+    std::vector<uint32_t> none;
+    lgfx::bitmap_header_t h;
+    if (bmp.size() < sizeof(h)) return none;
+    memcpy(&h, bmp.data(), sizeof(h));
+    if (h.bfType != 0x4D42 || h.bfSize != bmp.size() || h.biBitCount != 8 || h.biCompression != 1) return none;
+    if (h.biClrUsed < 1 || h.biClrUsed > 256 || h.bfOffBits + h.biSizeImage != h.bfSize) return none;
+    int width = h.biWidth, height = h.biHeight;
+    uint32_t palette[256];
+    memcpy(palette, bmp.data() + sizeof(h), 4 * h.biClrUsed);
+
+    std::vector<uint32_t> pixels(width * height, 0xFFFFFFFF);
+    const uint8_t *p = bmp.data() + h.bfOffBits, *end = bmp.data() + bmp.size();
+    int x = 0, y = height - 1;
+    auto put = [&](uint8_t i) -> bool
+    {
+        if (x >= width || y < 0 || i >= h.biClrUsed) return false;
+        pixels[y * width + x++] = palette[i] & 0xFFFFFF;
+        return true;
+    };
+    while (p + 2 <= end)
+    {
+        uint8_t n = *p++, c = *p++;
+        if (n)
+        {
+            while (n--) if (! put(c)) return none;
+        }
+        else if (c == 0)
+        {
+            if (x != width) return none;  // the encoder writes whole rows
+            x = 0;
+            y--;
+        }
+        else if (c == 1)
+        {
+            return x == width && y == 0 && p == end ? pixels : none;
+        }
+        else if (c == 2)
+        {
+            return none;  // the encoder writes no deltas
+        }
+        else
+        {
+            if (p + c + (c & 1) > end) return none;
+            for (int i = 0; i < c; i++) if (! put(p[i])) return none;
+            p += c + (c & 1);
+        }
+    }
+    return none;
+}
+
+
+static uint64_t usToSave(bool (*save)(LGFX &, const char *), const char *path)
+{
+    uint64_t ns = wallNanos();
+    CHECK(save(lcd, path));
+    return (wallNanos() - ns) / 1000;
+}
+
+
+static void palette200(LGFX &panel)
+{
+    uint32_t colors[200];
+    for (uint32_t &c : colors) c = (rand() << 8 ^ rand()) & 0xFFFFFF;
+    for (int y = 0; y < panel.height(); y++)
+        for (int x = 0; x < panel.width(); x++)
+            panel.setPixel888(x, y, colors[x / (1 + y % 3) % 200]);  // runs of 1, 2 and 3
+}
+
+
+/**
+ * The RLE8 file gives the screen back pixel by pixel, with the
+ * size and time against the 24-bit file of the same screen
+ */
+static void testRLE8()
+{
+    struct { const char *name; void (*draw)(LGFX &); } screens[] =
+        {{"grid", grid}, {"framedCrosshair", framedCrosshair}, {"200 colors", palette200}};
+    for (int rotation : {1, 0})
+    {
+        lcd.setRotation(rotation);
+        for (auto &screen : screens)
+        {
+            screen.draw(lcd);
+            uint64_t us24 = usToSave(saveBMPtoSD_24bit, "/shot24.bmp");
+            uint64_t us8  = usToSave(saveBMPtoSD_rle8, "/shot8.bmp");
+            std::vector<uint8_t> bmp = host::fileData("/shot8.bmp");
+            std::vector<uint32_t> pixels = decodeRLE8(bmp);
+            CHECK_EQ(pixels.size(), (size_t)(lcd.width() * lcd.height()));
+            int wrong = 0;
+            for (int y = 0; y < lcd.height() && ! pixels.empty(); y++)
+                for (int x = 0; x < lcd.width(); x++) wrong += pixels[y * lcd.width() + x] != lcd.pixel888(x, y);
+            CHECK_EQ(wrong, 0);
+            CHECK(host::fileData("/shot24.bmp") == reference24());
+
+            size_t size24 = host::fileData("/shot24.bmp").size();
+            printf("%-16s rot=%d  RLE8 %6u bytes %6u us  24-bit %6u bytes %6u us\n", screen.name, rotation,
+                   (unsigned)bmp.size(), (unsigned)us8, (unsigned)size24, (unsigned)us24);
+            CHECK(bmp.size() < size24);
+        }
+    }
+
+    // more than 256 colors, the 24-bit BMP
+    randomScreen();
+    CHECK(saveBMPtoSD_rle8(lcd, "/shot8.bmp"));
+    CHECK(host::fileData("/shot8.bmp") == reference24());
+}
+
+
+int main()
+{
+    srand(2432);
+    testFiles();
+    testPendingNotification();
+    testRLE8();
+
+    lcd.setRotation(1);
+    randomScreen();
+    bench("row at a time", legacy::saveBMPtoSD_24bit);
+    bandRows(1);
+    bench("bands of 1 row", saveBMPtoSD_24bit);
+    bandRows(0);
+    bench("bands", saveBMPtoSD_24bit);
+
+    // a default band is half of SCREENSHOT_MAX_BAND_BYTES
+    int rows = 16384 / 2 / (3 * lcd.width());
+    uint32_t reads = lcd.readRects();
+    CHECK(saveBMPtoSD_24bit(lcd, "/bench.bmp"));
+    CHECK_EQ(lcd.readRects() - reads, (uint32_t)(lcd.height() + rows - 1) / rows);
+    CHECK(host::fileWrites("/bench.bmp").size() <= 2 * (size_t)(lcd.height() + rows - 1) / rows + 2);
+    return testResult("screenshot_bench");
+}
@@ -0,0 +1,268 @@
+/**
+ * File         XPT2046Sim.cpp
+ *
+ * Purpose      Simulated XPT2046 touch controller (see XPT2046Sim.h)
+ */
+
+#include "XPT2046Sim.h"
+
+XPT2046Sim::XPT2046Sim(uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin, int8_t irqPin) :
+                       _mosiPin(mosiPin), _misoPin(misoPin), _clkPin(clkPin), _csPin(csPin), _irqPin(irqPin)
+{}
+
+
+XPT2046Sim::~XPT2046Sim()
+{
+    detach();
+}
+
+
+/**
+ * Connects the simulation to the pins for the bit-bang backend
+ */
+void XPT2046Sim::attachPins()
+{
+    host::attachDevice(this);
+    _pinsAttached = true;
+    _cs = host::pinLevel(_csPin);
+    _clk = host::pinLevel(_clkPin);
+    _updateIrq();
+}
+
+
+/**
+ * Connects the simulation to a hardware SPI bus, CS and 
+ * PENIRQ stay on pins
+ */
+void XPT2046Sim::attachSpi(uint8_t bus)
+{
+    host::attachSpiDevice(bus, this);
+    _spiBus = bus;
+    attachPins();
+}
+
+
+void XPT2046Sim::detach()
+{
+    if (_pinsAttached) host::detachDevice(this);
+    if (_spiBus >= 0) host::attachSpiDevice(_spiBus, nullptr);
+    _pinsAttached = false;
+    _spiBus = -1;
+}
+
+
+void XPT2046Sim::touch(int xValue, int yValue, int rTouch)
+{
+    _script.clear();
+    _penDown = true;
+    _xValue = xValue;
+    _yValue = yValue;
+    _rTouch = rTouch;
+    if (_pinsAttached) _updateIrq();
+}
+
+
+void XPT2046Sim::release()
+{
+    _script.clear();
+    _penDown = false;
+    if (_pinsAttached) _updateIrq();
+}
+
+
+/**
+ * Moves the pen along the keyframes, the times are counted from now.
+ * Between two keyframes with the pen down position and pressure are 
+ * interpolated linearly. After the last keyframe the pen stays there.
+ */
+void XPT2046Sim::play(const std::vector<Keyframe> &script)
+{
+    _script = script;
+    _nsStart = host::nanos();
+    _applyScript(_nsStart);
+    if (_pinsAttached) _updateIrq();
+}
+
+
+bool XPT2046Sim::isPlaying() const
+{
+    return ! _script.empty() && host::nanos() - _nsStart < _script.back().ms * 1000000ULL;
+}
+
+
+void XPT2046Sim::setNoise(int xyAmplitude, int zAmplitude)
+{
+    _noiseXY = xyAmplitude;
+    _noiseZ = zAmplitude;
+}
+
+
+void XPT2046Sim::setSpikes(int perMille, int amplitude)
+{
+    _spikePerMille = perMille;
+    _spikeAmplitude = amplitude;
+}
+
+
+void XPT2046Sim::setSettleError(int error)
+{
+    _settleError = error;
+}
+
+
+uint32_t XPT2046Sim::conversions() const
+{
+    uint32_t n = 0;
+    for (uint32_t c : _conversions) n += c;
+    return n;
+}
+
+
+void XPT2046Sim::resetCounters()
+{
+    for (uint32_t &c : _conversions) c = 0;
+}
+
+
+/**
+ * Uniform noise in -amplitude..amplitude from a linear 
+ * congruential generator, the same on every run
+ */
+int XPT2046Sim::_noise(int amplitude)
+{
+    if (amplitude <= 0) return 0;
+    _seed = _seed * 1103515245u + 12345u;
+    return (int)((_seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+
+/**
+ * Converts the channel selected by the command. Without touch
+ * X and Y float at the last position, Z1 is at the noise floor.
+ */
+uint16_t XPT2046Sim::convert(uint8_t command)
+{
+    int channel = (command >> 4) & 7;
+    int v = 0;
+    _conversions[channel]++;
+    if (_script.size()) _applyScript(host::nanos());
+
+    // Rtouch = Rx-plate * X / 4096 * (Z2 / Z1 - 1)
+    int k = std::max(1, _rxPlate * _xValue >> 12);
+    int z1 = _penDown ? std::min(1000, 4000 * k / (k + _rTouch)) : 0;
+    switch (channel)
+    {
+        case CH_X:  v = _xValue + _noise(_noiseXY); break;
+        case CH_Y:  v = _yValue + _noise(_noiseXY); break;
+        case CH_Z1: v = z1 + _noise(_noiseZ); break;
+        case CH_Z2: v = _penDown ? z1 + _rTouch * z1 / k + _noise(_noiseZ) : 4095; break;
+    }
+    if (_penDown && (channel == CH_X || channel == CH_Y))
+    {
+        if (channel != _lastChannel) v -= _settleError;
+        int u = _noise(500) + 500;   // 0..1000
+        if (u < _spikePerMille) v += (u & 1) ? _spikeAmplitude : -_spikeAmplitude;
+    }
+    _lastChannel = channel;
+    _latch(command);
+    return (uint16_t)std::min(std::max(v, 0), 4095);
+}
+
+
+/**
+ * The power down bits of the command 
+ * enable or disable PENIRQ
+ */
+void XPT2046Sim::_latch(uint8_t command)
+{
+    _command = command;
+    _penIrqEnabled = (command & 3) == 0;
+    _updateIrq();
+}
+
+
+void XPT2046Sim::_updateIrq()
+{
+    if (_irqPin >= 0 && _pinsAttached) host::setPin(_irqPin, (_penDown && _penIrqEnabled) ? LOW : HIGH);
+}
+
+
+void XPT2046Sim::_applyScript(uint64_t ns)
+{
+    if (_script.empty()) return;
+    uint32_t ms = (uint32_t)((ns - _nsStart) / 1000000ULL);
+    size_t i = 0;
+    while (i + 1 < _script.size() && _script[i + 1].ms <= ms) i++;
+    const Keyframe &a = _script[i];
+    _penDown = a.penDown && ms >= a.ms;
+    _xValue = a.xValue;
+    _yValue = a.yValue;
+    _rTouch = a.rTouch;
+    if (i + 1 < _script.size() && a.penDown && _script[i + 1].penDown && ms >= a.ms)
+    {
+        const Keyframe &b = _script[i + 1];
+        int t = (int)(ms - a.ms), d = (int)(b.ms - a.ms);
+        _xValue += (b.xValue - a.xValue) * t / d;
+        _yValue += (b.yValue - a.yValue) * t / d;
+        _rTouch += (b.rTouch - a.rTouch) * t / d;
+    }
+}
+
+
+void XPT2046Sim::onTime(uint64_t ns)
+{
+    if (_script.empty()) return;
+    bool wasDown = _penDown;
+    _applyScript(ns);
+    if (_penDown != wasDown) _updateIrq();
+}
+
+
+/**
+ * Decodes the bit-bang protocol on the pins
+ */
+void XPT2046Sim::onPinWrite(uint8_t pin, uint8_t level)
+{
+    if (pin == _csPin)
+    {
+        _cs = level;
+        _bitsIn = _bitsOut = 0;
+        return;
+    }
+    if (pin != _clkPin || _cs == HIGH || _spiBus >= 0) return;
+    bool rising = _clk == LOW && level == HIGH;
+    bool falling = _clk == HIGH && level == LOW;
+    _clk = level;
+
+    if (rising && _bitsIn < 8)
+    {
+        _command = (_command << 1) | (host::pinLevel(_mosiPin) ? 1 : 0);
+        if (++_bitsIn == 8 && (_command & 0x80))
+        {
+            _shiftOut = convert(_command) << 3;   // busy bit, then 12 bits MSB first
+            _bitsOut = 0;
+        }
+    }
+    else if (falling && _bitsIn == 8)
+    {
+        // falling edge 0 follows the command, 16 more follow in the 16 read clocks
+        host::setPin(_misoPin, _bitsOut < 16 && (_shiftOut & (0x8000 >> _bitsOut)) ? HIGH : LOW);
+        if (++_bitsOut == 17) _bitsIn = 0;   // ready for the next command
+    }
+}
+
+
+uint8_t XPT2046Sim::transfer(uint8_t data)
+{
+    if (data & 0x80) _shiftOut = convert(data) << 3;
+    return 0;
+}
+
+
+uint16_t XPT2046Sim::transfer16(uint16_t data)
+{
+    (void)data;
+    uint16_t v = _shiftOut;
+    _shiftOut = 0;
+    return v;
+}
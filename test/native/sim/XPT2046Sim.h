@@ -0,0 +1,116 @@
+/**
+ * Header       XPT2046Sim.h
+ *
+ * Purpose      Simulated XPT2046 touch controller of the host build.
+ *              It answers the commands of the driver like the real chip:
+ *                - bit-bang: while CS is low, the command byte is shifted in
+ *                  on 8 rising edges of DCLK, the busy bit and the 12 bit 
+ *                  result are shifted out on the following falling edges
+ *                - hardware SPI: transfer() takes the command, transfer16()
+ *                  returns the busy bit and the result left aligned
+ *              The channels of CMD_READ_X, CMD_READ_Y, CMD_READ_Z1 and 
+ *              CMD_READ_Z2 return the raw position and the pressure of the 
+ *              pen, Z1 and Z2 follow from the touch resistance with formula 1
+ *              of the datasheet, so XPT2046_Pressure.h computes it back.
+ *              PENIRQ goes low while the pen touches and the last command 
+ *              powered the controller down (PD1 = PD0 = 0).
+ *
+ *              The pen is moved with touch() / release() or by a script of
+ *              keyframes, between which position and pressure are interpolated.
+ *              The values get a deterministic noise (setNoise()), occasional 
+ *              spikes (setSpikes()) and an error of the first conversion after
+ *              switching the channel, while the reference settles (setSettleError()).
+ *              SimTransport answers directly without pins, as a mock backend 
+ *              of XPT2046_Transport.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "Host.h"
+#include "XPT2046_Transport.h"
+
+class XPT2046Sim : public host::PinDevice, public host::SpiDevice
+{
+    public:
+        using Keyframe = struct kfrm
+        {
+            uint32_t ms;        // since play()
+            bool     penDown;
+            int      xValue;
+            int      yValue;
+            int      rTouch;    // touch resistance in ohms
+        };
+
+        enum { CH_X = 1, CH_Z1 = 3, CH_Z2 = 4, CH_Y = 5 };
+
+        XPT2046Sim(uint8_t mosiPin, uint8_t misoPin, uint8_t clkPin, uint8_t csPin, int8_t irqPin = -1);
+        ~XPT2046Sim();
+        void attachPins();
+        void attachSpi(uint8_t bus);
+        void detach();
+
+        void touch(int xValue, int yValue, int rTouch = 400);
+        void release();
+        void play(const std::vector<Keyframe> &script);
+        bool isPlaying() const;
+        void setNoise(int xyAmplitude, int zAmplitude);
+        void setSpikes(int perMille, int amplitude);
+        void setSettleError(int error);
+        void setPlateResistance(int rxPlate) { _rxPlate = rxPlate; }
+
+        uint16_t convert(uint8_t command);   // result of a conversion
+        uint32_t conversions(int channel) const { return _conversions[channel & 7]; }
+        uint32_t conversions() const;
+        void     resetCounters();
+        bool     isTouched() const { return _penDown; }
+
+        void     onPinWrite(uint8_t pin, uint8_t level) override;
+        void     onTime(uint64_t ns) override;
+        uint8_t  transfer(uint8_t data) override;
+        uint16_t transfer16(uint16_t data) override;
+
+    private:
+        uint8_t  _mosiPin, _misoPin, _clkPin, _csPin;
+        int8_t   _irqPin;
+        bool     _pinsAttached = false;
+        int      _spiBus = -1;
+        uint8_t  _cs = HIGH, _clk = LOW;
+        int      _bitsIn = 0;
+        uint8_t  _command = 0;
+        uint16_t _shiftOut = 0;
+        int      _bitsOut = 0;
+        bool     _penIrqEnabled = true;
+        bool     _penDown = false;
+        int      _xValue = 0, _yValue = 0, _rTouch = 0;
+        int      _rxPlate = 300;
+        int      _noiseXY = 0, _noiseZ = 0;
+        int      _spikePerMille = 0, _spikeAmplitude = 0;
+        int      _settleError = 0;
+        int      _lastChannel = -1;
+        uint32_t _seed = 12345;
+        std::vector<Keyframe> _script;
+        uint64_t _nsStart = 0;
+        uint32_t _conversions[8] = {};
+
+        int  _noise(int amplitude);
+        void _latch(uint8_t command);
+        void _updateIrq();
+        void _applyScript(uint64_t ns);
+};
+
+
+class SimTransport : public XPT2046_Transport
+{
+    public:
+        SimTransport(XPT2046Sim &sim) : _sim(sim) {}
+        void begin() override {}
+        void setClockFrequency(uint32_t hz) override { (void)hz; }
+        void select() override {}
+        void deselect() override {}
+        uint16_t transfer(uint8_t command) override { return _sim.convert(command); }
+        const char *name() override { return "sim"; }
+
+    private:
+        XPT2046Sim &_sim;
+};
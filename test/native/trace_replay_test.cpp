@@ -0,0 +1,137 @@
+/**
+ * File         trace_replay_test.cpp
+ *
+ * Purpose      Touch traces recorded by the driver in PENIRQ mode, read with
+ *              TraceReader and replayed with replayTrace(): every touch ends
+ *              with a pen up record, the replay produces the same events as
+ *              the live touches, independent of the speed of the replay, and
+ *              a trace of a later version with longer header and records is
+ *              still read.
+ */
+
+#include <vector>
+#include "check.h"
+#include "XPT2046_Bitbang.h"
+#include "XPT2046Sim.h"
+
+static LGFX lcd;
+
+using Event = struct evnt { TouchEventType type; int x, y; uint32_t duration; };
+static std::vector<Event> events;
+
+static void onEvent(void *ctx, const TouchEvent &ev)
+{
+    (void)ctx;
+    events.push_back(Event {ev.type, ev.x, ev.y, ev.duration});
+}
+
+static void subscribeAll(XPT2046_Bitbang &touchpad)
+{
+    for (int t = TOUCH_SHORT; t < TOUCH_EVENT_TYPES; t++) touchpad.subscribe((TouchEventType)t, onEvent);
+}
+
+static bool sameEvents(const std::vector<Event> &a, const std::vector<Event> &b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].type != b[i].type || a[i].x != b[i].x || a[i].y != b[i].y || a[i].duration != b[i].duration) return false;
+    }
+    return true;
+}
+
+
+int main()
+{
+    host::useVirtualTime();
+
+    // a tap and a swipe, sampled by loop() with PENIRQ
+    host::MemoryStream trace;
+    std::vector<Event> live;
+    {
+        XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS, TP_IRQ);
+        XPT2046_Bitbang touchpad(lcd, TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+        sim.attachPins();
+        sim.setNoise(4, 4);
+        touchpad.begin();
+        touchpad.useIrq(TP_IRQ);
+        subscribeAll(touchpad);
+        touchpad.startTrace(trace);
+        sim.play({{ 100, true, 2000, 2000, 400},
+                  { 200, true, 2000, 2000, 400},
+                  { 201, false,   0,    0,   0},
+                  { 600, true,  800, 2400, 400},
+                  { 850, true, 3000, 2000, 400},
+                  { 851, false,   0,    0,   0}});
+        uint32_t ms = millis();
+        while (millis() - ms < 1500) touchpad.loop();
+        touchpad.stopTrace();
+        live.swap(events);
+    }
+
+    // every touch ends with a pen up record
+    TraceReader reader;
+    TraceRecord r;
+    int records = 0, penUps = 0;
+    bool wasDown = false;
+    uint32_t msLast = 0;
+    CHECK(reader.begin(trace.data().data(), trace.data().size()));
+    while (reader.next(r))
+    {
+        if (! r.penDown)
+        {
+            CHECK(wasDown);
+            penUps++;
+        }
+        CHECK(r.ms >= msLast);
+        wasDown = r.penDown;
+        msLast = r.ms;
+        records++;
+    }
+    CHECK_EQ(penUps, 2);
+    CHECK(! wasDown);
+    int gestures = 0;
+    for (const Event &ev : live) gestures += ev.type < TOUCH_PEN_DOWN;
+    CHECK_EQ(gestures, 2);
+    printf("%d records, %u bytes, %u events\n", records, (unsigned)trace.data().size(), (unsigned)live.size());
+
+    // replayed without delay, the time of the records is taken from the trace
+    XPT2046Sim sim(TP_MOSI, TP_MISO, TP_SCLK, TP_CS);
+    SimTransport bus(sim);
+    XPT2046_Bitbang touchpad(lcd, bus);
+    touchpad.begin();
+    subscribeAll(touchpad);
+    trace.rewind();
+    uint32_t ms = millis();
+    CHECK_EQ(touchpad.replayTrace(trace), (size_t)records);
+    CHECK_EQ(millis() - ms, 0);
+    CHECK(sameEvents(events, live));
+
+    // in real time
+    events.clear();
+    trace.rewind();
+    ms = millis();
+    CHECK_EQ(touchpad.replayTrace(trace, true), (size_t)records);
+    CHECK_NEAR(millis() - ms, msLast, 2);     // the records count from startTrace()
+    CHECK(sameEvents(events, live));
+
+    // a later version with 4 more bytes in the header and each record
+    std::vector<uint8_t> v2(trace.data().begin(), trace.data().begin() + XPT2046_TRACE_HEADER_SIZE);
+    v2[3] += 4;
+    v2[4] += 4;
+    v2.insert(v2.end(), 4, 0xEE);
+    for (size_t i = XPT2046_TRACE_HEADER_SIZE; i < trace.data().size(); i += XPT2046_TRACE_RECORD_SIZE)
+    {
+        v2.insert(v2.end(), trace.data().begin() + i, trace.data().begin() + i + XPT2046_TRACE_RECORD_SIZE);
+        v2.insert(v2.end(), 4, 0xEE);
+    }
+    events.clear();
+    host::MemoryStream in(v2);
+    CHECK_EQ(touchpad.replayTrace(in), (size_t)records);
+    CHECK(sameEvents(events, live));
+    int n = 0;
+    CHECK(reader.begin(v2.data(), v2.size()));
+    while (reader.next(r)) n++;
+    CHECK_EQ(n, records);
+    return testResult("trace_replay_test");
+}
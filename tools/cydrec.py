@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+File         cydrec.py
+
+Purpose      Converts a screen recording made with startRecording() /
+             recordFrame() (src/recordScreenToSD.cpp) into 24-bit BMP files.
+             The frames are restored by drawing the changed tiles of each
+             frame over the previous one. With --frame only one frame is
+             written, it is restored from the nearest keyframe before it.
+             A recording without index, e.g. after a reset of the CYD, is
+             read frame by frame from the start.
+
+Usage        python3 tools/cydrec.py recording.cdr outdir [--frame N]
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+END_OF_FRAME = 0xFFFF
+
+
+class Recording:
+    def __init__(self, data):
+        if data[:4] != b"CYDR":
+            raise ValueError("not a screen recording")
+        version, header_size, self.width, self.height, self.tile, self.bpp = \
+            struct.unpack_from("<BBHHBB", data, 4)
+        if version != 1 or self.bpp != 3:
+            raise ValueError("unsupported version %d or %d bytes per pixel" % (version, self.bpp))
+        self.data = data
+        self.tiles_x = (self.width + self.tile - 1) // self.tile
+        self.offsets = self._read_index() or self._scan(header_size)
+
+    def _read_index(self):
+        if len(self.data) < 8 or self.data[-4:] != b"CYDX":
+            return None
+        (offset,) = struct.unpack_from("<I", self.data, len(self.data) - 8)
+        if self.data[offset:offset + 1] != b"I":
+            return None
+        (count,) = struct.unpack_from("<I", self.data, offset + 4)
+        return list(struct.unpack_from("<%dI" % count, self.data, offset + 8))
+
+    def _scan(self, offset):
+        offsets = []
+        while True:
+            try:
+                end = self._frame_end(offset)
+            except (struct.error, ValueError):
+                break  # the last frame is incomplete
+            offsets.append(offset)
+            offset = end
+        return offsets
+
+    def _tile_size(self, n):
+        x = (n % self.tiles_x) * self.tile
+        y = (n // self.tiles_x) * self.tile
+        return x, y, min(self.tile, self.width - x), min(self.tile, self.height - y)
+
+    def _frame_end(self, offset):
+        if self.data[offset:offset + 1] != b"F":
+            raise ValueError("no frame at offset %d" % offset)
+        offset += 8
+        while True:
+            (n,) = struct.unpack_from("<H", self.data, offset)
+            offset += 2
+            if n == END_OF_FRAME:
+                return offset
+            x, y, w, h = self._tile_size(n)
+            offset += 3 * w * h
+            if offset > len(self.data):
+                raise ValueError("truncated tile")
+
+    def info(self, i):
+        flags, ms = struct.unpack_from("<B2xI", self.data, self.offsets[i] + 1)
+        return bool(flags & 1), ms
+
+    def apply(self, i, screen):
+        """Draws the tiles of frame i over screen (b,g,r rows top down)"""
+        offset = self.offsets[i] + 8
+        line = 3 * self.width
+        while True:
+            (n,) = struct.unpack_from("<H", self.data, offset)
+            offset += 2
+            if n == END_OF_FRAME:
+                return
+            x, y, w, h = self._tile_size(n)
+            for r in range(h):
+                start = (y + r) * line + 3 * x
+                screen[start:start + 3 * w] = self.data[offset:offset + 3 * w]
+                offset += 3 * w
+
+    def keyframe_before(self, i):
+        while i > 0 and not self.info(i)[0]:
+            i -= 1
+        return i
+
+
+def write_bmp(path, width, height, screen):
+    line = 3 * width
+    row_size = (line + 3) & ~3
+    pad = bytes(row_size - line)
+    with open(path, "wb") as f:
+        f.write(struct.pack("<2sIHHI", b"BM", 54 + row_size * height, 0, 0, 54))
+        f.write(struct.pack("<IiiHHIIiiII", 40, width, height, 1, 24, 0, row_size * height, 0, 0, 0, 0))
+        for y in range(height - 1, -1, -1):
+            f.write(screen[y * line:(y + 1) * line])
+            f.write(pad)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Converts a CYD screen recording into BMP files")
+    parser.add_argument("recording")
+    parser.add_argument("outdir")
+    parser.add_argument("--frame", type=int, help="write this frame only")
+    args = parser.parse_args()
+
+    with open(args.recording, "rb") as f:
+        rec = Recording(f.read())
+    count = len(rec.offsets)
+    if args.frame is not None and not 0 <= args.frame < count:
+        sys.exit("the recording has %d frames" % count)
+    os.makedirs(args.outdir, exist_ok=True)
+
+    screen = bytearray(3 * rec.width * rec.height)
+    first, last = (0, count - 1) if args.frame is None else (rec.keyframe_before(args.frame), args.frame)
+    for i in range(first, last + 1):
+        rec.apply(i, screen)
+        if args.frame is None or i == args.frame:
+            key, ms = rec.info(i)
+            write_bmp(os.path.join(args.outdir, "frame%05d.bmp" % i), rec.width, rec.height, screen)
+            print("frame %5d  %8d ms%s" % (i, ms, "  keyframe" if key else ""))
+    print("%d of %d frames, %d x %d pixels" % (last - first + 1, count, rec.width, rec.height))
+
+
+if __name__ == "__main__":
+    main()